@@ -0,0 +1,23 @@
+include(../core/core.pri)
+
+QT += opengl concurrent
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+TARGET = 3d-reconstruction
+TEMPLATE = app
+
+SOURCES += \
+	../src/main.cpp \
+	../src/viewport.cpp \
+	../src/mainwindow.cpp \
+	../src/tools-widget.cpp \
+	../src/renderer.cpp \
+	../src/trackball.cpp
+
+HEADERS += \
+	../include/renderer.h \
+	../include/tools-widget.h \
+	../include/mainwindow.h \
+	../include/trackball.h \
+	../include/viewport.h
@@ -0,0 +1,11 @@
+# Микробенчмарки ядра (консольные, без GUI). Собираются вместе с остальными подпроектами,
+# запускаются вручную: 3d-reconstruction-bench [число слоев [контрольная сумма для сравнения]]
+include(../core/core.pri)
+
+TARGET = 3d-reconstruction-bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += \
+	../src/matrix-bench.cpp
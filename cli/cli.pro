@@ -0,0 +1,15 @@
+include(../core/core.pri)
+
+QT += concurrent
+
+TARGET = 3d-reconstruction-cli
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += \
+	../src/cli-main.cpp \
+	../src/batch-job.cpp
+
+HEADERS += \
+	../include/batch-job.h
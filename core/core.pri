@@ -0,0 +1,16 @@
+# Подключение ядра (core.pro) к приложению или утилите
+QT += core gui concurrent
+CONFIG += c++11
+
+INCLUDEPATH += $$PWD/../include
+
+CORE_BUILD_DIR = $$OUT_PWD/../core
+win32 {
+	CONFIG(debug, debug|release): CORE_BUILD_DIR = $$CORE_BUILD_DIR/debug
+	else: CORE_BUILD_DIR = $$CORE_BUILD_DIR/release
+}
+
+LIBS += -L$$CORE_BUILD_DIR -l3d-reconstruction-core
+
+win32-msvc*: PRE_TARGETDEPS += $$CORE_BUILD_DIR/3d-reconstruction-core.lib
+else: PRE_TARGETDEPS += $$CORE_BUILD_DIR/lib3d-reconstruction-core.a
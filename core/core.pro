@@ -0,0 +1,66 @@
+# Ядро: обработка изображений, подгонка слоев, построение и экспорт моделей.
+# Статическая библиотека, не зависит ни от OpenGL, ни от виджетов - используется приложением,
+# пакетной утилитой и может встраиваться в сторонние (в т.ч. многопоточные) программы.
+QT = core gui concurrent
+
+TARGET = 3d-reconstruction-core
+TEMPLATE = lib
+CONFIG += staticlib c++11
+
+INCLUDEPATH = ../include
+
+SOURCES += \
+	../src/any.cpp \
+	../src/mesh.cpp \
+	../src/point-grid.cpp \
+	../src/box-tree.cpp \
+	../src/triangle-tree.cpp \
+	../src/output-buffer.cpp \
+	../src/algebra.cpp \
+	../src/point-kernels.cpp \
+	../src/ellipse-creator.cpp \
+	../src/compact-mesh.cpp \
+	../src/points-mover.cpp \
+	../src/default-points-mover.cpp \
+	../src/symmetric-points-mover.cpp \
+	../src/cylindrical-sweep.cpp \
+	../src/model-creator.cpp \
+	../src/cylindical-model-creator.cpp \
+	../src/scene.cpp \
+	../src/history.cpp \
+	../src/session.cpp \
+	../src/timer.cpp
+
+HEADERS += \
+	../include/any.h \
+	../include/defs.h \
+	../include/aabb.h \
+	../include/vec2.h \
+	../include/vec3.h \
+	../include/matrix.h \
+	../include/algebra.h \
+	../include/lsm.h \
+	../include/line.h \
+	../include/plane.h \
+	../include/triang.h \
+	../include/triangle.h \
+	../include/mesh.h \
+	../include/point-grid.h \
+	../include/box-tree.h \
+	../include/triangle-tree.h \
+	../include/output-buffer.h \
+	../include/point-kernels.h \
+	../include/compact-mesh.h \
+	../include/anchor-layers.h \
+	../include/image.h \
+	../include/points-mover.h \
+	../include/ellipse-creator.h \
+	../include/default-points-mover.h \
+	../include/symmetric-points-mover.h \
+	../include/cylindrical-sweep.h \
+	../include/model-creator.h \
+	../include/cylindical-model-creator.h \
+	../include/scene.h \
+	../include/history.h \
+	../include/session.h \
+	../include/timer.h
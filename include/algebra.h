@@ -105,8 +105,8 @@ template<class T, int dim>
 matrix<T, dim> operator +(const matrix<T, dim>& lhs, const matrix<T, dim>& rhs) {
   matrix<T, dim> src;
   T* cur = src.data();
-  T* curL = lhs.data();
-  T* curR = rhs.data();
+  const T* curL = lhs.data();
+  const T* curR = rhs.data();
   for(int i = 0; i<dim*dim; ++i) *cur++ = (*curL++) + (*curR++);
   return src;
 }
@@ -115,8 +115,8 @@ template<class T, int dim>
 matrix<T, dim> operator -(const matrix<T, dim>& lhs, const matrix<T, dim>& rhs) {
   matrix<T, dim> src;
   T* cur = src.data();
-  T* curL = lhs.data();
-  T* curR = rhs.data();
+  const T* curL = lhs.data();
+  const T* curR = rhs.data();
   for(int i = 0; i<dim*dim; ++i) *cur++ = (*curL++) - (*curR++);
   return src;
 }
@@ -134,6 +134,32 @@ matrix<T, dim> operator *(const matrix<T, dim>& lhs, const matrix<T, dim>& rhs)
   return src;
 }
 
+// 3x3 и 4x4 (повороты, преобразования вершин) - без циклов
+template<class T>
+matrix<T, 3> operator *(const matrix<T, 3>& lhs, const matrix<T, 3>& rhs) {
+  matrix<T, 3> src;
+  for(int j = 0; j<3; ++j) {
+    T r0 = rhs(0, j), r1 = rhs(1, j), r2 = rhs(2, j);
+    src(0, j) = lhs(0, 0)*r0 + lhs(0, 1)*r1 + lhs(0, 2)*r2;
+    src(1, j) = lhs(1, 0)*r0 + lhs(1, 1)*r1 + lhs(1, 2)*r2;
+    src(2, j) = lhs(2, 0)*r0 + lhs(2, 1)*r1 + lhs(2, 2)*r2;
+  }
+  return src;
+}
+
+template<class T>
+matrix<T, 4> operator *(const matrix<T, 4>& lhs, const matrix<T, 4>& rhs) {
+  matrix<T, 4> src;
+  for(int j = 0; j<4; ++j) {
+    T r0 = rhs(0, j), r1 = rhs(1, j), r2 = rhs(2, j), r3 = rhs(3, j);
+    src(0, j) = lhs(0, 0)*r0 + lhs(0, 1)*r1 + lhs(0, 2)*r2 + lhs(0, 3)*r3;
+    src(1, j) = lhs(1, 0)*r0 + lhs(1, 1)*r1 + lhs(1, 2)*r2 + lhs(1, 3)*r3;
+    src(2, j) = lhs(2, 0)*r0 + lhs(2, 1)*r1 + lhs(2, 2)*r2 + lhs(2, 3)*r3;
+    src(3, j) = lhs(3, 0)*r0 + lhs(3, 1)*r1 + lhs(3, 2)*r2 + lhs(3, 3)*r3;
+  }
+  return src;
+}
+
 template<class T>
 vec3<T> operator *(const vec3<T>& rhs, const matrix<T, 3>& lhs) {
   return vec3<T>(
@@ -0,0 +1,17 @@
+﻿#ifndef ANCHOR_LAYERS_H_INCLUDED__
+#define ANCHOR_LAYERS_H_INCLUDED__
+
+#include <array>
+#include <QVector>
+#include <vec2.h>
+
+namespace rn {
+  // Опорные точки слоя протяга: концы большой оси эллипса-основания и точка на его малой оси
+  using AnchorLayer = std::array<vec2i, 3>;
+
+  // Слои подряд в одном буфере с фиксированным шагом - без отдельного выделения памяти на каждый слой;
+  // копии разделяют буфер до первого изменения, слой передается ссылкой на элемент
+  using AnchorLayers = QVector<AnchorLayer>;
+}
+
+#endif // ANCHOR_LAYERS_H_INCLUDED__
@@ -0,0 +1,38 @@
+﻿#ifndef BATCH_JOB_H_INCLUDED__
+#define BATCH_JOB_H_INCLUDED__
+
+#include <QString>
+
+namespace rn {
+  // Реконструкция моделей без GUI по описанию в формате JSON:
+  //   {
+  //     "image": "bottle.jpg",       - путь к изображению (относительно файла описания)
+  //     "step": 4,                   - шаг между слоями
+  //     "slices": 16,                - число разбиений эллипса-основания
+  //     "tolerance": 0,              - допустимое отклонение при разрежении слоев (0 - без разрежения)
+  //     "mode": "default",           - "default" | "symmetric" - способ подгонки точек слоя
+  //     "texturing": "none",         - "none" | "mirror" | "cyclically"
+  //     "objects": [
+  //       {
+  //         "basis": [[x, y], [x, y], [x, y]], - концы большой оси основания и точка на малой оси
+  //         "sweep": [x, y]                    - точка, до которой протягивается модель
+  //       }
+  //     ]
+  //   }
+  // Все координаты задаются в пикселях исходного изображения.
+  class BatchJob {
+  public:
+    QString input; // файл описания
+    QString output; // файл результата, формат определяется по расширению (obj, ply, stl, glb)
+    QString error; // описание ошибки, если она произошла
+    bool succeeded;
+
+  public:
+    BatchJob();
+    BatchJob(const QString& input, const QString& output);
+
+    bool run();
+  };
+}
+
+#endif // BATCH_JOB_H_INCLUDED__
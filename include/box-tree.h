@@ -0,0 +1,62 @@
+﻿#ifndef BOX_TREE_H_INCLUDED__
+#define BOX_TREE_H_INCLUDED__
+
+#include <QVector>
+#include <vec2.h>
+
+namespace rn {
+  // Иерархия ограничивающих прямоугольников (BVH) на плоскости XY: поиск объектов, чьи прямоугольники
+  // содержат точку или пересекаются с областью. Строится один раз, при изменении прямоугольников
+  // отдельных объектов обновляются только их предки. Перенос и отражение всех прямоугольников, как и в
+  // PointGrid, учитываются преобразованием запросов.
+  class BoxTree {
+  public:
+    struct Box { // границы включаются
+      vec2i min, max;
+
+      Box();
+      Box(const vec2i& min, const vec2i& max);
+
+      bool isEmpty() const;
+      bool contains(const vec2i& point) const;
+      bool contains(const Box& box) const;
+      bool intersects(const Box& box) const;
+      Box united(const Box& box) const;
+    };
+
+  private:
+    struct Node {
+      Box box;
+      int parent;
+      int first, second; // дочерние узлы; у листа second < 0, а first - номер объекта
+    };
+
+    QVector<Node> nodes_; // корень - nodes_[0], дочерние узлы идут после родителя
+    QVector<int> leaves_; // лист каждого объекта
+
+    vec2i offset_;
+    int flip_x_; // текущие координаты x - flip_x_ * x + offset_.x
+
+    Box toLocal(const Box& box) const;
+    Box toGlobal(const Box& box) const;
+    int build(QVector<int>& items, int begin, int end, const QVector<Box>& boxes, int parent);
+
+  public:
+    BoxTree();
+    explicit BoxTree(const QVector<Box>& boxes);
+
+    int size() const; // число объектов
+    bool isEmpty() const;
+    size_t memoryUsage() const; // байт
+    Box bounds() const;
+
+    void update(int item, const Box& box); // новый прямоугольник объекта
+    void move(const vec2i& diff); // переносит все прямоугольники
+    void mirror(int anchor); // x -> anchor - (x - anchor)
+
+    QVector<int> find(const vec2i& point) const; // номера объектов, чьи прямоугольники содержат точку
+    QVector<int> find(const Box& area) const; // ... пересекаются с областью
+  };
+}
+
+#endif // BOX_TREE_H_INCLUDED__
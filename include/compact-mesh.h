@@ -0,0 +1,42 @@
+﻿#ifndef COMPACT_MESH_H_INCLUDED__
+#define COMPACT_MESH_H_INCLUDED__
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <vec2.h>
+#include <vec3.h>
+#include <anchor-layers.h>
+
+namespace rn {
+  // Компактное представление модели - то, что уходит на отрисовку и в экспорт (Mesh::compact, Mesh::fromCompact).
+  // Все массивы плоские, индексы треугольников ссылаются на общие для всех атрибутов номера вершин.
+  // За вершинами слоев идут вершины крышек (если у крышки есть треугольники): сначала верхней, затем нижней.
+  // У каждой крышки свои копии вершин обода и затем ее центр - ребро между крышкой и боковой поверхностью
+  // жесткое, их нормали в вершинах не смешиваются.
+  // Координаты - локальные, как у Mesh; обход треугольников согласован с нормалью в этой СК.
+  struct CompactMesh {
+    std::vector<vec3f> positions; // целые координаты модели (до 2^24) во float представимы точно
+    std::vector<std::array<uint32_t, 3>> indices; // боковая поверхность, затем верхняя и нижняя крышки
+    std::vector<uint32_t> normals; // нормали вершин - среднее по прилежащим треугольникам, см. encodeNormal
+    std::vector<vec2f> tex_coord; // пуст, если у модели нет текстурных координат
+    std::vector<vec2i> anchors; // опорные точки, по anchors_per_layer на слой подряд
+    std::vector<int> layers; // границы слоев: first, second подряд
+    std::vector<uint32_t> rims; // для копий вершин обода крышек - исходные вершины слоев (верхняя, затем нижняя)
+    int top_rim = 0; // из них - у верхней крышки
+    int top_triangles = 0;
+    int bottom_triangles = 0;
+
+    static const int anchors_per_layer = std::tuple_size<AnchorLayer>::value;
+
+    int sideTriangles() const;
+    size_t memoryUsage() const; // байт
+  };
+
+  // Октаэдрическое кодирование единичного вектора: проекция на октаэдр |x| + |y| + |z| = 1, развернутая
+  // в квадрат, по 16 бит на координату. Погрешность направления - порядка 1e-4 рад.
+  uint32_t encodeNormal(const vec3d& n);
+  vec3f decodeNormal(uint32_t code);
+}
+
+#endif // COMPACT_MESH_H_INCLUDED__
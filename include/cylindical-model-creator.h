@@ -1,58 +1,74 @@
 ﻿#ifndef CYLINDICAL_MODEL_CREATOR_H_INCLUDED__
 #define CYLINDICAL_MODEL_CREATOR_H_INCLUDED__
 
+#include <memory>
+#include <atomic>
+#include <QFutureWatcher>
+
 #include <model-creator.h>
-#include <points-mover.h>
+#include <cylindrical-sweep.h>
 
 namespace rn {
   class CylindricalModelCreator : public ModelCreator {
   protected:
-    vec2i coord_;
+    // результат протягивания в пуле потоков
+    struct SweepResult {
+      int generation = 0; // номер построения (основания), для которого выполнялся расчет
+      bool completed = false; // расчет не был отменен
+      int step = 0;
+      AnchorLayers layers;
+      QVector<vec2i> last_layer;
+      Mesh::HardPtr mesh;
+    };
+
+
     vec2i offset_mouse_; // центр системы координат - центр изображения
     int clicks_counter_; // подсчитывает клики по изображению
-    double inclination_angle_; // угол наклона эллипса вокруг оси z
-    double rotation_angle_; // угол кручения эллипса вокруг оси x
     Mesh::HardPtr current_mesh_;
 
-    std::shared_ptr<PointsMover> points_mover_;
+    CylindricalSweep sweep_; // построение модели по основанию и положению мыши
+    AnchorLayer basis_; // основание модели (задается первыми кликами)
 
-    QVector<QVector<vec2i>> prev_layers_; // предыдущие слои (сформированные)
-    QVector<vec2i> basis_; // основание модели (задается первыми кликами)
+    // Протягивание до положения мыши выполняется в пуле потоков над копией sweep_, поток GUI не ждет
+    // "прилипания". Одновременно считается не более одного протяга: положения мыши, пришедшие во время
+    // расчета, не прерывают его - по завершении запускается расчет для последнего из них (побеждает
+    // последнее), а до тех пор показывается последняя готовая модель. Прерываются только расчеты,
+    // ставшие ненужными: при сбросе построения, смене сессии или способа подгонки.
+    QFutureWatcher<SweepResult> sweep_watcher_;
+    std::shared_ptr<std::atomic_bool> sweep_cancel_; // флаг отмены текущего расчета (при смене поколения)
+    bool sweep_pending_; // положение мыши изменилось во время расчета
+    int sweep_generation_; // меняется при сбросе построения - результаты прежних расчетов отбрасываются
 
   private:
-    void correctStep();
-    void updateMover();
+    void updateSweep();
     void goToOverview();
     void toProcessBasis();
-    void defInclinationAngle();
-    void toSpecify(QVector<vec2i>& points, vec2d normal = vec2d(0, 0), double length = 0.0, vec2d* dir = nullptr);
-
-    QVector<vec2d> defTexCoord(QVector<vec3i> src, const QVector<vec2i>& base);
 
     void updateMesh();
     void goToUpdateMesh();
-
-    void recreate(Mesh::HardPtr mesh, const QVector<QVector<vec2i>>& anchor_points);
-    QVector<vec3i> createLayerPoints(const QVector<vec2i>& key_points); // создает слой искомой модели
-    QVector<vec2i> createEllipseByThreePoints(const QVector<vec2i>& points);
+    void startSweep();
+    void cancelSweep();
+    void onSweepFinished();
 
   public:
     CylindricalModelCreator();
+    ~CylindricalModelCreator();
 
+    void setSessionData(std::shared_ptr<rn::Session> data) override;
     void setPointsMover(const CreatingMode& mode) override;
 
     void smoothWithLSM(Mesh::HardPtr mesh, int ds);
     void smoothWithAveraging(Mesh::HardPtr mesh);
 
     void place(Mesh::HardPtr mesh, int radius) override;
-    Mesh::HardPtr createMeshFromLayers(const QVector<QVector<vec2i>>& layers) override;
+    Mesh::HardPtr createMeshFromLayers(const AnchorLayers& layers) override;
 
     void onMousePress(Qt::MouseButton button) override;
     void onMouseRelease(Qt::MouseButton button) override;
     void onMouseMove(int x, int y) override;
     void OnInterruptRequest() override;
 
-    void render() override;
+    Preview preview() const override;
   };
 }
 
@@ -0,0 +1,85 @@
+﻿#ifndef CYLINDRICAL_SWEEP_H_INCLUDED__
+#define CYLINDRICAL_SWEEP_H_INCLUDED__
+
+#include <memory>
+#include <atomic>
+#include <QVector>
+
+#include <vec2.h>
+#include <mesh.h>
+#include <session.h>
+#include <points-mover.h>
+#include <anchor-layers.h>
+
+namespace rn {
+  // Построение цилиндрической модели протягиванием эллипса-основания вдоль оси с "прилипанием" к границам
+  // объекта на изображении. Не зависит ни от виджетов, ни от OpenGL: используется как редактором, так и
+  // пакетной обработкой.
+  class CylindricalSweep {
+  public:
+    enum TexturingMode { // значения совпадают с ModelCreator::TexturingMode
+      Mirror,
+      Cyclically
+    };
+
+  protected:
+    double inclination_angle_; // угол наклона эллипса вокруг оси z
+    double rotation_angle_; // угол кручения эллипса вокруг оси x
+    rn::Session::HardPtr data_; // данные текущей сессии
+
+    std::shared_ptr<PointsMover> points_mover_;
+
+    AnchorLayer basis_; // основание модели
+    AnchorLayers layers_; // сформированные слои
+
+  private:
+    int layerSlices(int radius, int max_radius) const; // число точек слоя по его радиусу
+    void correctStep(const vec2i& target);
+    void updateMover();
+    void toSpecify(AnchorLayer& points, vec2d normal = vec2d(0, 0), double length = 0.0, vec2d* dir = nullptr);
+
+  public:
+    int texturing_mode;
+    bool using_texturing; // текстурировать ли создаваемую модель
+
+  public:
+    CylindricalSweep();
+
+    void setSessionData(rn::Session::HardPtr data);
+    void setPointsMover(std::shared_ptr<PointsMover> mover);
+
+    void reset();
+    void defInclinationAngle(const vec2i& first, const vec2i& second); // по первым двум точкам основания
+    // копия для расчета в другом потоке: свои PointsMover и снимок данных сессии (шаг меняется только в нем)
+    CylindricalSweep detached() const;
+
+    void start(const AnchorLayer& basis); // основание: концы большой оси эллипса и точка на малой оси
+    // протягивает модель от основания до указанной точки (СК сцены); флаг cancel проверяется перед
+    // каждым слоем, при отмене возвращает false, а сформированные слои не полны
+    bool extendTo(const vec2i& target, const std::atomic_bool* cancel = nullptr);
+    double distTo(const vec2i& target) const; // расстояние от последнего слоя до точки
+
+    double inclinationAngle() const;
+    double rotationAngle() const;
+    int step() const; // текущий шаг между слоями (знак - направление протягивания)
+    const AnchorLayers& layers() const;
+    void setLayers(const AnchorLayers& layers); // принимает слои, протянутые копией (detached)
+
+    // оставляет слои, без которых линейная интерполяция между соседними оставшимися отклоняется от опорных
+    // точек не более чем на tolerance: на прямых участках слоев становится мало, на изгибах и перепадах
+    // ширины - остаются все; первый и последний слои сохраняются всегда, между оставшимися - не более 64 шагов
+    static AnchorLayers thin(const AnchorLayers& layers, double tolerance);
+
+    Mesh::HardPtr createMeshFromLayers(const AnchorLayers& layers);
+    void recreate(Mesh::HardPtr mesh, const AnchorLayers& anchor_points);
+
+    QVector<vec3i> createLayerPoints(const AnchorLayer& key_points); // создает слой искомой модели
+    // то же для всех слоев сразу; число точек слоя зависит от его радиуса (см. layerSlices)
+    QVector<QVector<vec3i>> createLayersPoints(const AnchorLayers& layers);
+    QVector<vec2i> createEllipseByThreePoints(const AnchorLayer& points) const;
+    // текстурные координаты всех слоев протяга подряд (в порядке вершин модели); bases - опорные точки слоев
+    QVector<vec2d> defTexCoords(const QVector<QVector<vec3i>>& ellipses, const AnchorLayers& bases) const;
+  };
+}
+
+#endif // CYLINDRICAL_SWEEP_H_INCLUDED__
@@ -7,7 +7,8 @@ class DefaultPointsMover: public PointsMover {
 public:
   DefaultPointsMover() = default;
 
-  void move(QVector<vec2i>& points) override;
+  void move(rn::AnchorLayer& points) override;
+  std::shared_ptr<PointsMover> clone() const override;
 };
 
 #endif // DEFAULT_POINTS_MOVER_H_INCLUDED__
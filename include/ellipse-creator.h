@@ -1,9 +1,14 @@
 ﻿#ifndef ELLIPSE_CREATOR_H_INCLUDED__
 #define ELLIPSE_CREATOR_H_INCLUDED__
 
+#include <QVector>
 #include <vec2.h>
 
 namespace rn {
+  // Точки единичной окружности: count точек с шагом 2*Pi/count, начиная с угла 0.
+  // Таблицы кэшируются по count (число ломтиков меняется редко), возвращается разделяемая копия.
+  QVector<vec2d> unitCircle(int count);
+
   template<class T>
   class EllipseCreator {
     vec2<T> center_;
@@ -34,16 +39,19 @@ namespace rn {
       angle_ = angle;
     }
 
-    QVector<vec2<T>> create(int count) { // Создает эллипс, образуемый указанным количеством точек
+    QVector<vec2<T>> create(int count) const { // Создает эллипс, образуемый ровно count точками
+      if (count <= 0) return QVector<vec2<T>>();
+
+      // масштаб по полуосям и поворот сведены в одну матрицу 2x2, применяемую к единичной окружности
       double _cos = cos(angle_), _sin = sin(angle_);
-      double step = 2.0 * math::Pi / count;
-
-      QVector<vec2<T>> dst;
-      dst.reserve(count);
-      for (double angle = 0.0; angle < math::Pi * 2.0; angle += step) {
-        double t1 = param_a_*cos(angle), t2 = param_b_*sin(angle);
-        vec2<T> point(T(t1*_cos - t2*_sin), T(t1*_sin + t2*_cos));
-        dst.push_back(point + center_);
+      double xx = param_a_*_cos, xy = -param_b_*_sin;
+      double yx = param_a_*_sin, yy = param_b_*_cos;
+
+      auto circle = unitCircle(count);
+      QVector<vec2<T>> dst(count);
+      for (int i = 0; i < count; ++i) {
+        auto& u = circle[i];
+        dst[i] = vec2<T>(T(xx*u.x + xy*u.y), T(yx*u.x + yy*u.y)) + center_;
       }
 
       return dst;
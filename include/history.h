@@ -0,0 +1,60 @@
+﻿#ifndef HISTORY_H_INCLUDED__
+#define HISTORY_H_INCLUDED__
+
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <scene.h>
+
+namespace rn {
+  // История состояний сцены для отмены действий. Состояния разделяют неизмененные модели между собой
+  // и с текущей сценой (хранятся только указатели), а копии моделей (перенесенные, отраженные) - еще и
+  // геометрию. Поэтому память занимает лишь геометрия, которой в текущей сцене уже нет, - каждая
+  // учитывается один раз. Если ее объем превышает бюджет, самые старые состояния отбрасываются.
+  class History {
+    // геометрия моделей истории, которой нет в текущей сцене
+    struct Geometry {
+      int meshes; // число таких моделей с этой геометрией
+      size_t bytes; // учтенный объем (без самих объектов Mesh)
+    };
+
+    QVector<Scene> states_; // от старых к новым
+    QHash<const Mesh*, int> refs_; // число состояний, ссылающихся на модель
+    QHash<quint64, Geometry> geometry_;
+
+    // текущая сцена, относительно которой посчитан footprint_: модели и их геометрия
+    QVector<QPair<const Mesh*, quint64>> current_;
+    QSet<const Mesh*> alive_;
+    QSet<quint64> alive_geometry_;
+
+    size_t budget_;
+    size_t footprint_;
+
+    void hold(const Scene& scene); // учитывает ссылки состояния (относительно current_)
+    void drop(const Scene& scene); // снимает их, освободившаяся память вычитается сразу
+    bool changed(const Scene& current) const;
+    void recount(const Scene& current); // полный пересчет - только при смене текущей сцены
+    void evict();
+
+  public:
+    explicit History(size_t budget = 256 * 1024 * 1024);
+
+    void setBudget(size_t bytes);
+    size_t budget() const;
+
+    // Обновляет учет памяти и вытесняет старые состояния. current - текущая сцена: ее модели в бюджет
+    // истории не входят (модели, замененные после последнего push, учитываются только здесь);
+    // если сцена с прошлого раза не менялась, пересчета нет.
+    void update(const Scene& current);
+
+    void push(const Scene& scene, const Scene& current);
+    Scene pop(); // последнее сохраненное состояние
+    void clear();
+
+    int size() const;
+    bool isEmpty() const;
+    size_t footprint() const; // память (байт), занимаемая историей сверх текущей сцены
+  };
+}
+
+#endif // HISTORY_H_INCLUDED__
@@ -34,7 +34,11 @@ private:
   struct {
     QAction* open;
     QAction* save;
+    QAction* save_ply;
+    QAction* save_stl;
+    QAction* save_glb;
     QAction* save_each;
+    QAction* save_each_to_dir;
 
   } menu_file_;
 
@@ -53,6 +57,7 @@ private:
     QComboBox* mode;
     QComboBox* step;
     QComboBox* slices;
+    QComboBox* tolerance;
     QAction* texturing;
     QComboBox* texturing_mode;
     QAction* unite_meshes;
@@ -76,6 +81,9 @@ private:
   void createMenuFile();
 
   void onSelectionChange();
+  void updateUndoAction(); // доступность и подсказка (число шагов и память истории)
+  void afterSceneEdit(); // пересчитывает память истории по измененной сцене и обновляет подсказку
+  void saveMeshes(const QString& format); // все модели сцены одним файлом, format - расширение (obj, ply, stl, glb)
 
   void askAboutSaving();
 
@@ -102,6 +110,7 @@ private slots:
   void slotSaveMeshes();
   void slotMakeScreenshot();
   void slotSaveEachMeshes();
+  void slotSaveEachMeshesToDir(); // все модели в каталог по шаблону имени, в фоне
   void slotUndoLastAction();
 
   void slotChangeCreatingMode(bool checked);
@@ -2,17 +2,21 @@
 #define MATRIX_H_INCLUDED__
 
 #include <array>
-#include <assert.h>
+#include <cmath>
+#include <utility>
+#include <type_traits>
 
 #include <vec3.h>
 
 #undef minor
 
+// Квадратная матрица фиксированного размера. Элементы хранятся в самом объекте (по столбцам), поэтому
+// матрица тривиально копируется и не обращается к куче; для 3x3 и 4x4 определитель и обратная
+// матрица вычисляются по явным формулам, без приведения к треугольному виду.
 template<class T, int dim>
 class matrix {
 protected:
-  const int count_;
-  T* data_;
+  std::array<T, dim*dim> data_;
 
   inline T& at(int i, int j) {
     return data_[j*dim + i];
@@ -52,7 +56,7 @@ private:
   matrix<T, dim>& swapCols(int c1, int c2) {
     if (c1 == c2) return *this;
     for (auto i = 0; i<dim; ++i) {
-      swap(at(i, c1), at(i, c2));
+      std::swap(at(i, c1), at(i, c2));
     }
 
     return *this;
@@ -79,31 +83,126 @@ private:
     return *this;
   }
 
-public:
-  matrix() : count_(dim*dim), data_(new T[dim*dim]) {}
-  explicit matrix(T value) :
-    count_(dim*dim),
-    data_(new T[dim*dim])
-  {
-    T* cur = data_;
-    for (int i = 0; i < count_; ++i) *cur++ = value;
+  /* Определитель: в общем случае - приведением к треугольному виду, для малых размеров - явно */
+  template<int n>
+  T detImpl(std::integral_constant<int, n>) const {
+    matrix<T, dim> temp(*this);
+    int permut;
+    temp.toUpperTriang(&permut);
+    T dst = 1;
+    for (int i = 0; i<dim; ++i) {
+      dst *= temp(i, i);
+    }
+    if (permut % 2 == 1) dst = -dst;
+    return dst;
   }
+  T detImpl(std::integral_constant<int, 2>) const {
+    return at(0, 0)*at(1, 1) - at(0, 1)*at(1, 0);
+  }
+  T detImpl(std::integral_constant<int, 3>) const {
+    return at(0, 0)*(at(1, 1)*at(2, 2) - at(1, 2)*at(2, 1))
+         - at(0, 1)*(at(1, 0)*at(2, 2) - at(1, 2)*at(2, 0))
+         + at(0, 2)*(at(1, 0)*at(2, 1) - at(1, 1)*at(2, 0));
+  }
+  T detImpl(std::integral_constant<int, 4>) const {
+    // миноры 2x2 двух верхних и двух нижних строк (разложение Лапласа)
+    T s0 = at(0, 0)*at(1, 1) - at(1, 0)*at(0, 1), s1 = at(0, 0)*at(1, 2) - at(1, 0)*at(0, 2);
+    T s2 = at(0, 0)*at(1, 3) - at(1, 0)*at(0, 3), s3 = at(0, 1)*at(1, 2) - at(1, 1)*at(0, 2);
+    T s4 = at(0, 1)*at(1, 3) - at(1, 1)*at(0, 3), s5 = at(0, 2)*at(1, 3) - at(1, 2)*at(0, 3);
+    T c5 = at(2, 2)*at(3, 3) - at(3, 2)*at(2, 3), c4 = at(2, 1)*at(3, 3) - at(3, 1)*at(2, 3);
+    T c3 = at(2, 1)*at(3, 2) - at(3, 1)*at(2, 2), c2 = at(2, 0)*at(3, 3) - at(3, 0)*at(2, 3);
+    T c1 = at(2, 0)*at(3, 2) - at(3, 0)*at(2, 2), c0 = at(2, 0)*at(3, 1) - at(3, 0)*at(2, 1);
+    return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+  }
+
+  /* Обратная матрица: в общем случае - методом Гаусса-Жордана, для 3x3 и 4x4 - через присоединенную */
+  template<int n>
+  matrix<T, dim> inverseImpl(std::integral_constant<int, n>) const {
+    matrix<T, dim> src(*this), dst(identity());
+    for (int k = 0; k < dim; ++k) {
+      int ind = src.maxAbsInCol(k);
+      src.swapRows(k, ind);
+      dst.swapRows(k, ind);
+
+      T pivot = src(k, k);
+      for (int j = 0; j < dim; ++j) {
+        src(k, j) /= pivot;
+        dst(k, j) /= pivot;
+      }
 
-  matrix(const matrix<T, dim>& matrix) :
-    count_(dim*dim),
-    data_(new T[dim*dim])
-  {
-    for (int i = 0; i < count_; ++i) data_[i] = matrix.data_[i];
+      for (int i = 0; i < dim; ++i) {
+        if (i == k) continue;
+        T mn = src(i, k);
+        for (int j = 0; j < dim; ++j) {
+          src(i, j) -= src(k, j)*mn;
+          dst(i, j) -= dst(k, j)*mn;
+        }
+      }
+    }
+
+    return dst;
+  }
+  matrix<T, dim> inverseImpl(std::integral_constant<int, 3>) const {
+    matrix<T, dim> dst;
+    dst(0, 0) = at(1, 1)*at(2, 2) - at(1, 2)*at(2, 1);
+    dst(0, 1) = at(0, 2)*at(2, 1) - at(0, 1)*at(2, 2);
+    dst(0, 2) = at(0, 1)*at(1, 2) - at(0, 2)*at(1, 1);
+    dst(1, 0) = at(1, 2)*at(2, 0) - at(1, 0)*at(2, 2);
+    dst(1, 1) = at(0, 0)*at(2, 2) - at(0, 2)*at(2, 0);
+    dst(1, 2) = at(0, 2)*at(1, 0) - at(0, 0)*at(1, 2);
+    dst(2, 0) = at(1, 0)*at(2, 1) - at(1, 1)*at(2, 0);
+    dst(2, 1) = at(0, 1)*at(2, 0) - at(0, 0)*at(2, 1);
+    dst(2, 2) = at(0, 0)*at(1, 1) - at(0, 1)*at(1, 0);
+
+    T inv_det = T(1) / (at(0, 0)*dst(0, 0) + at(0, 1)*dst(1, 0) + at(0, 2)*dst(2, 0));
+    for (auto& e : dst.data_) e *= inv_det;
+    return dst;
   }
-  matrix(matrix<T, dim>&& matrix) :
-    count_(dim*dim),
-    data_(matrix.data_)
-  {
-    matrix.data_ = nullptr;
+  matrix<T, dim> inverseImpl(std::integral_constant<int, 4>) const {
+    T s0 = at(0, 0)*at(1, 1) - at(1, 0)*at(0, 1), s1 = at(0, 0)*at(1, 2) - at(1, 0)*at(0, 2);
+    T s2 = at(0, 0)*at(1, 3) - at(1, 0)*at(0, 3), s3 = at(0, 1)*at(1, 2) - at(1, 1)*at(0, 2);
+    T s4 = at(0, 1)*at(1, 3) - at(1, 1)*at(0, 3), s5 = at(0, 2)*at(1, 3) - at(1, 2)*at(0, 3);
+    T c5 = at(2, 2)*at(3, 3) - at(3, 2)*at(2, 3), c4 = at(2, 1)*at(3, 3) - at(3, 1)*at(2, 3);
+    T c3 = at(2, 1)*at(3, 2) - at(3, 1)*at(2, 2), c2 = at(2, 0)*at(3, 3) - at(3, 0)*at(2, 3);
+    T c1 = at(2, 0)*at(3, 2) - at(3, 0)*at(2, 2), c0 = at(2, 0)*at(3, 1) - at(3, 0)*at(2, 1);
+    T inv_det = T(1) / (s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0);
+
+    matrix<T, dim> dst;
+    dst(0, 0) = ( at(1, 1)*c5 - at(1, 2)*c4 + at(1, 3)*c3)*inv_det;
+    dst(0, 1) = (-at(0, 1)*c5 + at(0, 2)*c4 - at(0, 3)*c3)*inv_det;
+    dst(0, 2) = ( at(3, 1)*s5 - at(3, 2)*s4 + at(3, 3)*s3)*inv_det;
+    dst(0, 3) = (-at(2, 1)*s5 + at(2, 2)*s4 - at(2, 3)*s3)*inv_det;
+
+    dst(1, 0) = (-at(1, 0)*c5 + at(1, 2)*c2 - at(1, 3)*c1)*inv_det;
+    dst(1, 1) = ( at(0, 0)*c5 - at(0, 2)*c2 + at(0, 3)*c1)*inv_det;
+    dst(1, 2) = (-at(3, 0)*s5 + at(3, 2)*s2 - at(3, 3)*s1)*inv_det;
+    dst(1, 3) = ( at(2, 0)*s5 - at(2, 2)*s2 + at(2, 3)*s1)*inv_det;
+
+    dst(2, 0) = ( at(1, 0)*c4 - at(1, 1)*c2 + at(1, 3)*c0)*inv_det;
+    dst(2, 1) = (-at(0, 0)*c4 + at(0, 1)*c2 - at(0, 3)*c0)*inv_det;
+    dst(2, 2) = ( at(3, 0)*s4 - at(3, 1)*s2 + at(3, 3)*s0)*inv_det;
+    dst(2, 3) = (-at(2, 0)*s4 + at(2, 1)*s2 - at(2, 3)*s0)*inv_det;
+
+    dst(3, 0) = (-at(1, 0)*c3 + at(1, 1)*c1 - at(1, 2)*c0)*inv_det;
+    dst(3, 1) = ( at(0, 0)*c3 - at(0, 1)*c1 + at(0, 2)*c0)*inv_det;
+    dst(3, 2) = (-at(3, 0)*s3 + at(3, 1)*s1 - at(3, 2)*s0)*inv_det;
+    dst(3, 3) = ( at(2, 0)*s3 - at(2, 1)*s1 + at(2, 2)*s0)*inv_det;
+    return dst;
   }
 
-  ~matrix() {
-    if (data_) delete data_;
+  int maxAbsInCol(int col) const {
+    int res = col;
+    for (int i = col + 1; i<dim; ++i) {
+      if (std::abs(at(i, col))>std::abs(at(res, col))) res = i;
+    }
+
+    return res;
+  }
+
+public:
+  matrix() = default; // элементы не инициализируются
+  explicit matrix(T value) {
+    data_.fill(value);
   }
 
   inline T& operator ()(int i, int j) {
@@ -113,29 +212,12 @@ public:
     return data_[j*dim + i];
   }
 
-  matrix<T, dim>& operator =(const matrix<T, dim>& rhs) {
-    if (this == &rhs) return *this;
-    memcpy(data_, rhs.data_, dim*dim*sizeof(T));
-    return *this;
-  }
-  matrix<T, dim>& operator =(matrix<T, dim>&& rhs) {
-    if (this == &rhs) return *this;
-    if (data_) delete[] data_;
-    data_ = rhs.data_;
-    rhs.data_ = nullptr;
-    return *this;
-  }
-
   matrix<T, dim>& operator +=(const matrix<T, dim>& rhs) {
-    T* cur = data_;
-    T* cur2 = rhs.data_;
-    for (int i = 0; i < count_; ++i) *cur++ += *cur2++;
+    for (int i = 0; i < dim*dim; ++i) data_[i] += rhs.data_[i];
     return *this;
   }
   matrix<T, dim>& operator -=(const matrix<T, dim>& rhs) {
-    T* cur = data_;
-    T* cur2 = rhs.data_;
-    for (int i = 0; i < count_; ++i) *cur++ -= *cur2++;
+    for (int i = 0; i < dim*dim; ++i) data_[i] -= rhs.data_[i];
     return *this;
   }
   matrix<T, dim>& operator *=(const matrix<T, dim>& rhs) {
@@ -151,28 +233,29 @@ public:
   }
 
   void create(const T* source) {
-    for (int i = 0; i < count_; ++i) data_[i] = source[i];
+    for (int i = 0; i < dim*dim; ++i) data_[i] = source[i];
   }
 
-  inline T* data() const {
-    return data_;
+  inline T* data() {
+    return data_.data();
+  }
+  inline const T* data() const {
+    return data_.data();
   }
 
-  inline int count() const {
-    return count_;
+  static constexpr int count() {
+    return dim*dim;
   }
 
   matrix<T, dim>& fill(T val) {
-    T* cur = data_;
-    for (int i = 0; i < count_; ++i) *cur++ = val;
+    data_.fill(val);
     return *this;
   }
 
   matrix<T, dim>& transpose() {
-    matrix<T, dim> old(*this);
     for (int i = 0; i < dim; ++i) {
-      for (int j = 0; j < dim; ++j) {
-        at(i, j) = old(j, i);
+      for (int j = i + 1; j < dim; ++j) {
+        std::swap(at(i, j), at(j, i));
       }
     }
     return *this;
@@ -192,9 +275,9 @@ public:
     int num_row;
     for (int k = 0; k < dim - 1; ++k) {
       num_row = k;
-      while (abs(temp[num_row][k]) < Double::epsilon() && num_row < dim - 1) ++num_row;
-      if (abs(temp[num_row][k]) > Double::epsilon()) {
-        swap(temp[k], temp[num_row]);
+      while (std::abs(temp[num_row][k]) < Double::epsilon() && num_row < dim - 1) ++num_row;
+      if (std::abs(temp[num_row][k]) > Double::epsilon()) {
+        std::swap(temp[k], temp[num_row]);
         for (int j = k + 1; j < dim; ++j) {
           double mn = temp[j][k] / temp[k][k];
           for (int i = k; i < dim + 1; ++i) temp[j][i] -= temp[k][i] * mn;
@@ -215,7 +298,7 @@ public:
   }
 
   /* Возвращает значение соответствующего минора матрицы */
-  T minor(int row, int col) {
+  T minor(int row, int col) const {
     matrix<T, dim - 1> dst;
     for (int i = 0, ii = 0; i<dim; ++i, ++ii) {
       if (i == row) --ii;
@@ -232,15 +315,12 @@ public:
 
   /* Возвращает определитель матрицы */
   T det() const {
-    matrix<T, dim> temp(*this);
-    int permut;
-    temp.toUpperTriang(&permut);
-    T dst = 1;
-    for (int i = 0; i<dim; ++i) {
-      dst *= temp(i, i);
-    }
-    if (permut % 2 == 1) dst = -dst;
-    return dst;
+    return detImpl(std::integral_constant<int, dim>());
+  }
+
+  /* Возвращает обратную матрицу (матрица должна быть невырожденной) */
+  matrix<T, dim> inverse() const {
+    return inverseImpl(std::integral_constant<int, dim>());
   }
 
   static matrix<T, dim> zero() {
@@ -252,17 +332,16 @@ public:
     return temp;
   }
   static matrix<T, dim> scale(T scale) {
-    assert(dim >= 3);
+    static_assert(dim >= 3, "scale matrix needs at least 3 dimensions");
 
-    matrix<T, dim> temp(0);
+    matrix<T, dim> temp(identity());
     for (int i = 0; i < 3; ++i) temp(i, i) = scale;
-    temp(4, 4) = 1;
 
     return temp;
   }
   static matrix<T, dim> translation(const vec3<T>& shift) {
+    static_assert(dim >= 4, "translation matrix needs homogeneous coordinates");
 
-    assert(dim >= 4);
     matrix<T, dim> temp(identity());
     temp(3, 0) = shift.x;
     temp(3, 1) = shift.y;
@@ -6,16 +6,59 @@
 #include <array>
 #include <QPair>
 #include <QRect>
+#include <QImage>
 #include <QVector>
+#include <QList>
 #include <triangle.h>
 #include <algebra.h>
+#include <point-grid.h>
+#include <box-tree.h>
+#include <triangle-tree.h>
+#include <compact-mesh.h>
+#include <anchor-layers.h>
 
-typedef unsigned int GLuint;
 using layer_t = QPair<int, int>;
 using triangles_t = QVector<Trid>;
 
+// Хранимые координаты (vertices, вершины крышек, anchor_points) - локальные: move и mirror лишь меняют
+// отложенное преобразование в сцену, рисуется оно матрицей OpenGL, а к вершинам применяется в bake.
+// Методы Mesh его учитывают сами; код, которому нужны координаты сцены из открытых полей, вызывает bake.
+// Копии (clone) делят геометрию с исходной моделью (контейнеры Qt разделяются неявно) и отличаются лишь
+// преобразованием, пока одна из них не изменится; общую геометрию выдает совпадение geometryId.
 class Mesh {
   QVector<layer_t> layers_;
+  quint64 geometry_ = newGeometryId(); // меняется при каждом изменении геометрии
+
+  // координаты в сцене: (flip_x_ * x + offset_.x, y + offset_.y, z + offset_.z)
+  vec3i offset_ = vec3i(0, 0, 0);
+  int flip_x_ = 1;
+
+  // Вычисленные по вершинам данные помечены geometryId, для которой построены, и действительны, пока он не
+  // изменится: invalidate выдает новый id, а touch переносит на него пометки (данные остаются верными)
+
+  // индекс проекций вершин для dist: строится по требованию, переносится вместе с моделью
+  mutable rn::PointGrid grid_;
+  mutable quint64 grid_geometry_ = 0;
+
+  // центр и нормаль плоскости слоя, вычисляются по требованию
+  struct LayerInfo {
+    vec3d center;
+    vec3d normal; // по первым двум точкам слоя и центру
+    bool collapsed; // точек меньше трех или они практически слиты в одну
+  };
+  mutable QVector<LayerInfo> layers_info_;
+  mutable quint64 layers_info_geometry_ = 0;
+
+  // иерархия треугольников для пересечения с лучом (выбор модели в повернутом виде)
+  mutable rn::TriangleTree triangle_tree_;
+  mutable quint64 triangle_tree_geometry_ = 0;
+
+  // компактное представление для отрисовки и экспорта: одно на геометрию (geometryId), общее у копий
+  struct CompactCache {
+    quint64 geometry;
+    rn::CompactMesh mesh;
+  };
+  mutable std::shared_ptr<const CompactCache> compact_; // читается и из рабочих потоков - через atomic_load
 
   // нижняя и верхняя крышки - отдельно, для удобства слияния нескольких мешей
   struct Cover {
@@ -28,7 +71,16 @@ private:
   vec3i& vert(int index);
   const vec3i& vert(int index) const;
   vec2d& tex(int index);
-  const vec2d& tex(int index) const;
+
+  const rn::PointGrid& grid() const;
+  const QVector<LayerInfo>& layersInfo() const;
+  const rn::TriangleTree& triangleTree() const;
+  rn::CompactMesh makeCompact() const;
+  void invalidate(); // сбрасывает вычисленные по вершинам данные
+  void touch(); // геометрия изменилась, но вычисленные данные остаются верными
+  static quint64 newGeometryId();
+  template<class Index> void transformIndex(Index& index) const; // переводит свежепостроенный индекс в СК сцены
+  static std::shared_ptr<Mesh> baked(const std::shared_ptr<Mesh>& mesh); // сама модель или ее копия с примененным преобразованием
 
   vec3d layerCenter(const layer_t& layer) const; // возвращает точку - центр слоя
   static QPair<int, int> findNearestLayers(const Mesh& first, const Mesh& second);
@@ -42,9 +94,8 @@ public:
   QVector<vec3i> vertices;
   QVector<Trid> triangles;
   QVector<vec2d> tex_coord;
-  QVector<QVector<vec2i>> anchor_points;
+  rn::AnchorLayers anchor_points;
   Cover bottom_cover, top_cover; // нижняя и верхняя крышки" модели
-  GLuint texture_id = 0; // идентификатор текстуры для наложения
 
   Mesh() = default;
 
@@ -54,22 +105,45 @@ public:
   // просто сливает две модели в одну
   static Mesh::HardPtr merge(const Mesh::HardPtr& first, const Mesh::HardPtr& second);
 
-  void saveAsObj(const char* file);
+  bool saveAsObj(const char* file) const; // false - если файл не удалось записать
+  bool saveAsPly(const char* file) const; // бинарный PLY: позиции, нормали и текстурные координаты вершин
+  bool saveAsStl(const char* file) const; // бинарный STL
+  // glTF 2.0 (.glb) со встроенной текстурой (texture - изображение, к которому относятся tex_coord),
+  // crop_texture - встраивать только используемую моделью часть изображения
+  bool saveAsGlb(const char* file, const QImage& texture = QImage(), bool crop_texture = true) const;
+  bool save(const char* file, const QImage& texture = QImage()) const; // формат - по расширению (.ply, .stl, .glb, иначе OBJ)
+
+  // сохраняет несколько моделей в один файл, не собирая общую модель: модели пишутся друг за другом
+  // со смещением индексов, в glTF - по узлу на модель, а общая у копий геометрия - один раз
+  static bool saveScene(const QList<Mesh::HardPtr>& meshes, const char* file, const QImage& texture = QImage());
 
   void clear();
   Mesh& mirror(int anchor = 0); // если anchor = 0 - используется центральная ось модели
   Mesh& swap(Mesh* mesh);
   Mesh& move(const vec3i& diff);
+  bool hasTransform() const; // есть ли не примененное к вершинам преобразование
+  vec3i offset() const;
+  bool mirrored() const;
+  vec3i transformed(const vec3i& v) const; // локальные координаты (вершин, опорных точек) -> сцена
+  void bake(); // применяет отложенное преобразование к вершинам, крышкам и опорным точкам
+  quint64 geometryId() const; // одинаков у моделей с общей (не менявшейся после clone) геометрией
 
   vec3i center() const;
   double dist(const Mesh& other, bool by_covers = false) const; // by_covers = true: расстояние между первым и последним слоями мешей, иначе по всем точкам
+  rn::BoxTree::Box bounds() const; // габариты проекции модели на XY (вершины и опорные точки)
   bool fallsInto(const QRect& rect) const; // область модели пересекается с указанным прямоугольником
-  bool contains(const QPoint& point) const; // точка лежит в границах модели
+  // параметр t ближайшего пересечения луча с моделью (или limit, если ближе пересечений нет);
+  // triangle - номер треугольника: triangles, затем top_cover.triangles и bottom_cover.triangles
+  double intersect(const rn::Ray& ray, double limit = Double::max(), int* triangle = nullptr) const;
 
   Mesh::HardPtr clone() const;
+  std::shared_ptr<const rn::CompactMesh> compact() const; // представление для отрисовки и экспорта, координаты - локальные
+  static Mesh::HardPtr fromCompact(const rn::CompactMesh& src); // нормали граней - по обходу треугольников
+  size_t memoryUsage() const; // приблизительный объем памяти модели вместе с вычисленными индексами (байт)
 
   vec3i& operator[](int index);
   const vec3i& operator[](int index) const;
+  const vec2d& tex(int index) const; // текстурные координаты вершины (в т.ч. вершин крышек)
 
   void updateNormals();
 
@@ -83,14 +157,12 @@ public:
   void addTexCoords(const QVector<vec2d>& coords);
   void addLayer(const QVector<vec3i>& layer);
   void newLayer(const QVector<vec3i>& vertices);
-  void triangleLayers(const layer_t& first, const layer_t& second);
+  void triangleLayers(const layer_t& first, const layer_t& second); // число точек в слоях может различаться
 
   int getLayer(int vert_index) const;
   QPair<vertices_t::iterator, vertices_t::iterator> getLayerPoints(int layer);
 
   size_t addTriangle(size_t ind1, size_t ind2, size_t ind3); // индексы вершин
-
-  virtual void render(const vec3b& color = vec3b(70, 130, 180), bool texturing = true, bool selected = false) const;
 };
 
 #endif // MESH_H_INCLUDED__
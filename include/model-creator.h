@@ -4,6 +4,7 @@
 #include <memory>
 #include <QVector>
 #include <QObject>
+#include <QMap>
 
 #include <vec2.h>
 #include <session.h>
@@ -26,6 +27,13 @@ namespace rn {
       Symmetrically
     };
 
+    // то, что нужно показать пользователю в процессе создания модели (СК сцены)
+    struct Preview {
+      QVector<vec2i> line; // ось основания
+      QVector<vec2i> ellipse; // основание
+      Mesh::HardPtr mesh; // строящаяся модель
+    };
+
   protected:
     vec2i mouse_;
     QMap<Qt::MouseButton, bool> buttons_;
@@ -41,7 +49,7 @@ namespace rn {
     virtual ~ModelCreator();
 
     std::shared_ptr<rn::Session> data() const;
-    void setSessionData(std::shared_ptr<rn::Session> data);
+    virtual void setSessionData(std::shared_ptr<rn::Session> data);
     virtual void setPointsMover(const CreatingMode& mode);
 
     virtual void OnInterruptRequest();
@@ -50,12 +58,14 @@ namespace rn {
     virtual void onMouseRelease(Qt::MouseButton button);
 
     virtual void place(Mesh::HardPtr mesh, int radius);
-    virtual Mesh::HardPtr createMeshFromLayers(const QVector<QVector<vec2i>>& layers);
+    virtual Mesh::HardPtr createMeshFromLayers(const AnchorLayers& layers);
 
-    virtual void render() {};
+    virtual Preview preview() const;
 
   signals:
     void signalBeforeNewModelCreating();
+    void signalViewRotation(double degrees, double x, double y); // повернуть вид вокруг оси (x, y, 0)
+    void signalPreviewChanged(); // готова новая строящаяся модель (расчет выполнялся вне обработчика событий)
   };
 }
 
@@ -0,0 +1,94 @@
+﻿#ifndef OUTPUT_BUFFER_H_INCLUDED__
+#define OUTPUT_BUFFER_H_INCLUDED__
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <QtConcurrent>
+#include <QThreadPool>
+
+namespace rn {
+  // Буферизованная запись в файл: данные копируются в большой буфер и сбрасываются на диск целиком,
+  // без iostreams и без сброса на каждой строке. Подходит как для текстовых, так и для бинарных форматов.
+  class OutputBuffer {
+    std::FILE* file_;
+    std::vector<char> buffer_;
+    size_t size_;
+    bool failed_;
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+  public:
+    explicit OutputBuffer(const char* path, size_t capacity = 1 << 20);
+    ~OutputBuffer();
+
+    bool isOpen() const;
+    bool close(); // сбрасывает буфер и закрывает файл, false - если при записи произошла ошибка
+
+    void write(const void* data, size_t length);
+    void write(const char* str);
+    void write(const std::string& str);
+
+    template<class T>
+    void writeValue(const T& value) { // бинарная запись значения как есть (в памяти - little-endian)
+      write(&value, sizeof(T));
+    }
+
+    char* reserve(size_t length); // место под length байт для форматирования "на месте"
+    void commit(const char* end); // фиксирует данные, записанные с начала reserve() до end
+    void flush();
+  };
+
+  namespace format {
+    // быстрое форматирование чисел (в духе std::to_chars), возвращает указатель за последним символом
+    char* toChars(char* out, int value);
+    char* toChars(char* out, long long value);
+    char* toChars(char* out, double value, int precision = 6); // фиксированная точка без хвостовых нулей
+  }
+
+  // Форматирует count строк функцией format(char* out, int index) -> char* end и пишет их по порядку.
+  // Большие объемы форматируются кусками в общем пуле потоков Qt (вызывающий поток тоже участвует),
+  // куски дописываются в исходном порядке. max_line - верхняя граница длины одной строки.
+  template<class Format>
+  void writeLines(OutputBuffer& out, int count, size_t max_line, Format format) {
+    const int chunk = 1 << 15;
+    int threads = std::min(std::max(1, QThreadPool::globalInstance()->maxThreadCount()), (count + chunk - 1) / chunk);
+
+    if (threads < 2) {
+      for (int i = 0; i < count; ++i) {
+        out.commit(format(out.reserve(max_line), i));
+      }
+      return;
+    }
+
+    struct Part {
+      int begin, end;
+      std::string text;
+    };
+
+    std::vector<Part> parts(threads);
+    for (int first = 0; first < count; first += chunk * threads) {
+      for (int t = 0; t < threads; ++t) {
+        parts[t].begin = std::min(count, first + t * chunk);
+        parts[t].end = std::min(count, parts[t].begin + chunk);
+      }
+
+      QtConcurrent::blockingMap(parts, [&format, max_line](Part& part) {
+        part.text.resize((part.end - part.begin) * max_line);
+        char* p = &part.text[0];
+        for (int i = part.begin; i < part.end; ++i) {
+          p = format(p, i);
+        }
+        part.text.resize(p - part.text.data());
+      });
+
+      for (auto& part : parts) {
+        out.write(part.text);
+      }
+    }
+  }
+}
+
+#endif // OUTPUT_BUFFER_H_INCLUDED__
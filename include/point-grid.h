@@ -0,0 +1,50 @@
+﻿#ifndef POINT_GRID_H_INCLUDED__
+#define POINT_GRID_H_INCLUDED__
+
+#include <QVector>
+#include <vec2.h>
+#include <vec3.h>
+
+namespace rn {
+  // Равномерная сетка по проекциям точек на плоскость XY для поиска ближайших точек.
+  // Перенос и зеркальное отражение точек учитываются преобразованием запросов, без перестройки:
+  // текущие координаты точки p - (flip_x * p.x + offset.x, p.y + offset.y).
+  class PointGrid {
+    QVector<vec2i> points_; // точки (в СК построения), упорядоченные по ячейкам
+    QVector<int> cells_; // начало каждой ячейки в points_, последний элемент - points_.size()
+    vec2i min_, max_; // габариты точек (в СК построения)
+    int cell_size_;
+    int columns_, rows_;
+
+    vec2i offset_;
+    int flip_x_;
+
+    vec2i toLocal(const vec2i& point) const;
+    vec2i toGlobal(const vec2i& point) const;
+    long long sqrDistToBounds(const vec2i& local) const;
+
+  public:
+    PointGrid();
+    explicit PointGrid(const QVector<vec3i>& points);
+
+    int size() const;
+    bool isEmpty() const;
+    size_t memoryUsage() const; // байт
+
+    // габариты точек (с учетом переноса и отражения)
+    vec2i min() const;
+    vec2i max() const;
+
+    void move(const vec2i& diff);
+    void mirror(int anchor); // x -> anchor - (x - anchor)
+
+    // квадрат расстояния до ближайшей точки; если все точки не ближе sqr_limit - возвращает sqr_limit
+    long long sqrNearest(const vec2i& point, long long sqr_limit) const;
+
+    bool anyIn(const vec2i& min, const vec2i& max) const; // есть ли точки в прямоугольнике (границы включаются)
+
+    double dist(const PointGrid& other) const; // минимальное расстояние между точками двух сеток
+  };
+}
+
+#endif // POINT_GRID_H_INCLUDED__
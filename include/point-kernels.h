@@ -0,0 +1,43 @@
+﻿#ifndef POINT_KERNELS_H_INCLUDED__
+#define POINT_KERNELS_H_INCLUDED__
+
+#include <vector>
+#include <vec2.h>
+#include <vec3.h>
+#include <matrix.h>
+
+namespace rn {
+  // Координаты набора точек (или векторов) в виде структуры массивов: каждая координата - отдельный
+  // непрерывный массив. Циклы ядер ниже идут по этим массивам без ветвлений и без обращений к vec3,
+  // поэтому компилятор векторизует их инструкциями той архитектуры, под которую собирается проект.
+  struct Points3d {
+    std::vector<double> x, y, z;
+
+    Points3d() = default;
+    explicit Points3d(int count);
+    Points3d(const vec3i* points, int count, const vec3i& origin = vec3i(0, 0, 0)); // points[i] - origin
+
+    int size() const;
+    void resize(int count);
+
+    vec3d at(int i) const;
+    void set(int i, const vec3d& p);
+
+    // dst[i] = вектор i с отброшенной дробной частью (как vec3::to<int>) + shift
+    void store(vec3i* dst, const vec3i& shift = vec3i(0, 0, 0)) const;
+  };
+
+  // Пакетные аналоги операций vec3/mat3 над наборами точек; dst может совпадать с источником.
+  namespace kernels {
+    void transform(const Points3d& src, const mat3d& m, Points3d& dst); // dst[i] = src[i] * m (как vec3 * mat3)
+    void transform(const Points3d& src, const mat3d& m, Points3d& dst, int from, int count); // только [from, from + count)
+    void cross(const Points3d& a, const Points3d& b, Points3d& dst); // dst[i] = a[i] x b[i]
+    void orient(Points3d& normals, const Points3d& directions); // разворачивает нормали, смотрящие против directions
+    void normalize(Points3d& vectors);
+
+    // расстояние от p до ближайшей из точек (по проекциям на XY)
+    double minDistXY(const vec2d& p, const Points3d& points);
+  }
+}
+
+#endif // POINT_KERNELS_H_INCLUDED__
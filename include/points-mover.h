@@ -6,6 +6,7 @@
 
 #include <image.h>
 #include <vec2.h>
+#include <anchor-layers.h>
 
 class PointsMover {
 protected:
@@ -16,7 +17,7 @@ protected:
   bool look_ahead_; // заглядывать ли вперед, или нет
   std::shared_ptr<ip::Image<double>> grad_; // поле модулей градиента
   std::shared_ptr<ip::Image<double>> grad_dir_; // поле направлений градиента
-  QVector<QVector<vec2i>> prev_layers_; // все предыдущие точки (слои)
+  rn::AnchorLayers prev_layers_; // все предыдущие точки (слои)
 
 public:
   virtual ~PointsMover();
@@ -28,9 +29,10 @@ public:
   void setLookAhead(bool look);
   void setGradient(std::shared_ptr<ip::Image<double>> grad);
   void setGradientDir(std::shared_ptr<ip::Image<double>> dir);
-  void setPrevLayers(const QVector<QVector<vec2i>>& layers);
+  void setPrevLayers(const rn::AnchorLayers& layers);
 
-  virtual void move(QVector<vec2i>& points) = 0;
+  virtual void move(rn::AnchorLayer& points) = 0;
+  virtual std::shared_ptr<PointsMover> clone() const = 0; // копия с теми же параметрами (для другого потока)
 };
 
 #endif // POINTS_MOVER_H_INCLUDED__
@@ -0,0 +1,36 @@
+﻿#ifndef RENDERER_H_INCLUDED__
+#define RENDERER_H_INCLUDED__
+
+#include <QHash>
+#include <mesh.h>
+#include <model-creator.h>
+
+namespace rn {
+  // Отрисовка сцены средствами OpenGL. Ядро (Mesh, CylindricalSweep и т.п.) о ней ничего не знает,
+  // все обращения к OpenGL при построении моделей сосредоточены здесь и во Viewport.
+  class Renderer {
+    // Треугольники модели компилируются в список отображения один раз на геометрию: копии с общим
+    // geometryId рисуются одним списком, каждая со своей матрицей (конвейер OpenGL 1.x не знает
+    // instanced-отрисовки, списки - ее аналог).
+    struct DisplayList {
+      unsigned int id;
+      int frame; // кадр, в котором список использовался последним
+    };
+    mutable QHash<quint64, DisplayList> lists_; // ключ - geometryId * 2 + признак текстурирования
+    int frame_ = 0;
+
+    unsigned int displayList(const Mesh& mesh, bool texturing) const;
+
+  public:
+    Renderer() = default;
+
+    // текстура изображения должна быть уже привязана
+    void render(const Mesh& mesh, const vec3b& color = vec3b(70, 130, 180), bool texturing = true, bool selected = false) const;
+    void render(const ModelCreator::Preview& preview) const;
+
+    // удаляет списки геометрии, не рисовавшейся с прошлого вызова; вызывается в конце кадра
+    void collect();
+  };
+}
+
+#endif // RENDERER_H_INCLUDED__
@@ -0,0 +1,66 @@
+﻿#ifndef SCENE_H_INCLUDED__
+#define SCENE_H_INCLUDED__
+
+#include <QVector>
+#include <QList>
+#include <mesh.h>
+
+namespace rn {
+  // Модели сцены. Хранятся подряд в одном массиве (обход без лишних переходов), доступ к модели по
+  // дескриптору не зависит от удаления других моделей. Вставка, удаление и выделение - за O(1);
+  // при удалении на место модели переносится последняя, поэтому порядок моделей не сохраняется.
+  class Scene {
+  public:
+    struct Handle {
+      int slot = -1;
+      int generation = 0; // номер поколения слота: дескриптор удаленной модели не подходит к новой
+
+      bool isNull() const { return slot < 0; }
+      bool operator==(const Handle& other) const { return slot == other.slot && generation == other.generation; }
+      bool operator!=(const Handle& other) const { return !(*this == other); }
+    };
+
+  private:
+    struct Slot {
+      int index; // номер модели в meshes_, -1 - слот свободен
+      int generation;
+    };
+
+    QVector<Mesh::HardPtr> meshes_;
+    QVector<char> selected_; // флаги выделения, параллельно meshes_
+    QVector<int> slots_of_; // слот каждой модели, параллельно meshes_
+    QVector<Slot> slots_;
+    QVector<int> free_slots_;
+    int selected_count_;
+
+  public:
+    Scene();
+
+    int size() const;
+    bool isEmpty() const;
+    const Mesh::HardPtr& operator[](int index) const; // в порядке хранения
+    QVector<Mesh::HardPtr>::const_iterator begin() const;
+    QVector<Mesh::HardPtr>::const_iterator end() const;
+
+    Handle handle(int index) const;
+    int indexOf(const Handle& handle) const; // -1 - модель удалена
+    bool contains(const Handle& handle) const;
+    Mesh::HardPtr get(const Handle& handle) const; // nullptr - модель удалена
+
+    Handle insert(Mesh::HardPtr mesh, bool selected = false);
+    void remove(const Handle& handle);
+    void replace(const Handle& handle, Mesh::HardPtr mesh); // дескриптор и выделение сохраняются
+    void clear();
+
+    bool isSelected(int index) const;
+    void setSelected(const Handle& handle, bool selected = true);
+    void clearSelection();
+    int selectedCount() const;
+    QVector<Handle> selection() const; // дескрипторы выделенных моделей
+
+    QList<Mesh::HardPtr> meshes() const;
+    QList<Mesh::HardPtr> selectedMeshes() const;
+  };
+}
+
+#endif // SCENE_H_INCLUDED__
@@ -1,17 +1,20 @@
 ﻿#ifndef SESSION_H_INCLUDED__
 #define SESSION_H_INCLUDED__
 
-#include <QtOpenGL>
+#include <QList>
 #include <QVector>
 #include <QImage>
 #include <memory>
 #include <QPair>
+#include <QRect>
 
 #include <vec2.h>
 #include <mesh.h>
+#include <scene.h>
+#include <history.h>
 #include <image.h>
+#include <box-tree.h>
 
-class QGLWidget;
 #define MIN_SCENE_HEIGHT	768
 #define MIN_SCENE_WIDTH		1024
 
@@ -21,50 +24,54 @@ namespace rn {
     typedef std::shared_ptr<Session> HardPtr;
 
   private:
-    QGLWidget* parent_;
-    QVector<QList<Mesh::HardPtr>> backups_;
+    History history_; // состояния сцены для отмены действий
 
-    GLuint texture_;
-    GLuint gvf_texture_;
+    // иерархия габаритов моделей для выделения: перестраивается при изменении списка моделей,
+    // при перемещении отдельных моделей обновляется частично
+    QVector<const Mesh*> indexed_meshes_;
+    QVector<rn::BoxTree::Box> indexed_bounds_;
+    rn::BoxTree index_;
 
-    void checkOpenGLErrors();
+    void updateIndex();
 
   public:
     vec2i offsets;
     vec2i screen_size;
     int slices, step; // параметры детализации меша
+    int tolerance; // допустимое отклонение (пикс.) при разрежении слоев протяга, 0 - слои через каждый шаг
 
     QImage image;
     std::shared_ptr<ip::Image<double>> gvf;
     std::shared_ptr<ip::Image<double>> gvf_dir;
 
-    QList<Mesh::HardPtr> meshes;
+    Scene scene; // модели и их выделение
 
     QList<vec2i> first_layer;
     QList<vec2i> last_layer;
 
   public:
-    QList<Mesh::HardPtr> selected_meshes;
-
     Session() = default;
-    Session(const QImage& image, QGLWidget* parent);
-    ~Session();
+    explicit Session(const QImage& image);
 
     void commit();
     void rollback();
     bool hasBackups() const;
+    int backupsCount() const;
+    void updateBackups(); // учитывает изменения сцены после commit, старые состояния могут вытесняться
+    size_t backupsFootprint() const; // память, занимаемая историей сверх текущей сцены (байт), на момент commit или updateBackups
+    void setBackupsBudget(size_t bytes); // самые старые состояния вытесняются при превышении
 
+    HardPtr snapshot() const; // параметры построения моделей (без сцены и истории) - для расчетов в другом потоке
     void invertStep();
-    void addMesh(Mesh::HardPtr mesh);
+    Scene::Handle addMesh(Mesh::HardPtr mesh);
+    QVector<Scene::Handle> meshesIn(const QRect& rect); // модели, попадающие в прямоугольник (Mesh::fallsInto)
+    Scene::Handle pick(const rn::Ray& ray, int* triangle = nullptr) const; // ближайшая пересекаемая лучом модель
     void setLastLayer(const QVector<vec2i>& layer);
     void setFirstLayer(const QVector<vec2i>& layer);
 
     int width() const;
     int height() const;
     vec2i screenCenter() const;
-
-    GLuint texture() const;
-    GLuint gvfTexture() const;
   };
 }
 
@@ -7,7 +7,8 @@ class SymmetricPointsMover : public PointsMover {
 public:
   SymmetricPointsMover() = default;
 
-  void move(QVector<vec2i>& points) override;
+  void move(rn::AnchorLayer& points) override;
+  std::shared_ptr<PointsMover> clone() const override;
 };
 
 #endif // SYMMETRIC_POINTS_MOVER_H_INCLUDED__
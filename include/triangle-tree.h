@@ -0,0 +1,59 @@
+﻿#ifndef TRIANGLE_TREE_H_INCLUDED__
+#define TRIANGLE_TREE_H_INCLUDED__
+
+#include <QVector>
+#include <vec3.h>
+
+class Mesh;
+
+namespace rn {
+  // луч origin + t * dir, t >= 0
+  struct Ray {
+    vec3d origin;
+    vec3d dir;
+
+    Ray() = default;
+    Ray(const vec3d& origin, const vec3d& dir) : origin(origin), dir(dir) {
+
+    }
+  };
+
+  // Иерархия ограничивающих параллелепипедов (BVH) по треугольникам модели для поиска пересечений с лучом.
+  // Как и в PointGrid, перенос и отражение модели учитываются преобразованием луча, без перестройки.
+  class TriangleTree {
+    struct Tri {
+      vec3d a, ab, ac; // вершина и ребра из нее
+      int index; // номер треугольника: triangles, затем top_cover.triangles и bottom_cover.triangles
+    };
+
+    struct Node {
+      vec3d min, max;
+      int first; // лист - начало треугольников в tris_, иначе - левый потомок (правый - следующий за ним)
+      int count; // число треугольников листа, 0 - у внутреннего узла
+    };
+
+    QVector<Tri> tris_;
+    QVector<Node> nodes_;
+
+    vec3d offset_;
+    int flip_x_;
+
+    void build(int node, int begin, int end, QVector<vec3d>& centers);
+
+  public:
+    TriangleTree();
+    explicit TriangleTree(const Mesh& mesh);
+
+    int size() const;
+    bool isEmpty() const;
+    size_t memoryUsage() const; // байт
+
+    void move(const vec3d& diff);
+    void mirror(int anchor); // x -> anchor - (x - anchor)
+
+    // параметр t ближайшего пересечения с лучом; если пересечений ближе limit нет - возвращает limit
+    double intersect(const Ray& ray, double limit, int* triangle = nullptr) const;
+  };
+}
+
+#endif // TRIANGLE_TREE_H_INCLUDED__
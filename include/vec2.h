@@ -1,6 +1,9 @@
 ﻿#ifndef VEC2_H_INCLUDED__
 #define VEC2_H_INCLUDED__
 
+#include <cmath>
+#include <type_traits>
+
 template<class T>
 class vec2 {
 public:
@@ -81,7 +84,7 @@ public:
   }
 
   /* находится ли внутри треугольника */
-  bool in(const vec2<T>& a, const vec2<T>& b, const vec2<T>& c) {
+  bool in(const vec2<T>& a, const vec2<T>& b, const vec2<T>& c) const {
     if ((y - a.y)*(b.x - a.x) - (x - b.x)*(b.y - a.y)>0) return false;
     if ((y - b.y)*(c.x - b.x) - (x - c.x)*(c.y - b.y)>0) return false;
     if ((y - c.y)*(a.x - c.x) - (x - a.x)*(a.y - c.y)>0) return false;
@@ -89,7 +92,7 @@ public:
   }
 
   /* скалярное произведение */
-  double dot(const vec2<T>& rhs) {
+  double dot(const vec2<T>& rhs) const {
     return (x*rhs.x) + (y*rhs.y);
   }
   double length() const {
@@ -101,7 +104,7 @@ public:
   double sqrDist(const vec2<T>& rhs) const {
     return double((x - rhs.x)*(x - rhs.x) + (y - rhs.y)*(y - rhs.y));
   }
-  double angle(const vec2<T>& rhs) { //угол между ... и second
+  double angle(const vec2<T>& rhs) const { //угол между ... и second
     return acos(dot(rhs) / (length()*rhs.length()));
   }
 
@@ -110,7 +113,7 @@ public:
     return vec2<T2>(x*1.0 / t, y*1.0 / t);
   }
 
-  template<class T2> vec2<T2> to() {
+  template<class T2> vec2<T2> to() const {
     return vec2<T2>(T2(x), T2(y));
   }
 
@@ -119,6 +122,7 @@ public:
 };
 
 typedef vec2<double> vec2d;
+typedef vec2<float> vec2f;
 typedef vec2<int> vec2i;
 
 template<class T> vec2<T> vec2<T>::i = vec2<T>(1, 0);
@@ -105,10 +105,10 @@ public:
     return sqrt(x*x + y*y + z*z);
   }
 
-  double dot(const vec3<T>& rhs) { /* скалярное произведение */
+  double dot(const vec3<T>& rhs) const { /* скалярное произведение */
     return (x*rhs.x) + (y*rhs.y) + (z*rhs.z);
   }
-  double angle(const vec3<T>& rhs) {
+  double angle(const vec3<T>& rhs) const {
     return acos(double(x*rhs.x + y*rhs.y + z*rhs.z) / (length()*rhs.length()));
   }
   double dist(const vec3<T>& rhs) const {
@@ -137,7 +137,7 @@ public:
   }
 
   /* векторное произведение */
-  vec3<T> cross(const vec3<T>& rhs) {
+  vec3<T> cross(const vec3<T>& rhs) const {
     vec3<T> result;
     result.x = y*rhs.z - z*rhs.y;
     result.y = z*rhs.x - x*rhs.z;
@@ -151,7 +151,7 @@ public:
     return vec3<T2>(x*1.0 / t, y*1.0 / t, z*1.0 / t);
   }
 
-  template<class T2> vec3<T2> to() {
+  template<class T2> vec3<T2> to() const {
     return vec3<T2>(T2(x), T2(y), T2(z));
   }
 
@@ -9,6 +9,7 @@
 #include <vec3.h>
 #include <session.h>
 #include <trackball.h>
+#include <renderer.h>
 #include <model-creator.h>
 
 namespace rn
@@ -34,6 +35,13 @@ namespace rn
     QSize scene_size_;
     rn::Session::HardPtr session_;
 
+    GLuint texture_; // текстура изображения сессии
+    GLuint gvf_texture_; // текстура поля сил
+    Renderer renderer_;
+
+    void releaseTextures();
+    void checkOpenGLErrors();
+
     mesh_t makeCone(double radius, double height, int slices = 36);
     mesh_t makeCylinder(double radius, double height, int slices = 36);
 
@@ -45,6 +53,7 @@ namespace rn
     bool show_force_field;
     Trackball::HardPtr trackball;
     QVector<QPoint> selected_area;
+    Scene::Handle hovered_mesh; // модель под курсором, подсвечивается
     std::shared_ptr<ModelCreator> model_creator;
 
     explicit Viewport(QWidget* parent = nullptr);
@@ -53,6 +62,7 @@ namespace rn
     void setSession(rn::Session::HardPtr session);
 
     void makeScreenshot(const QString& filename);
+    rn::Ray pickRay(const QPoint& pos); // луч через точку виджета с учетом текущего поворота вида (СК сцены)
 
     void initializeGL() override;
     void resizeGL(int width, int height) override;
@@ -72,6 +82,7 @@ namespace rn
 
   public slots:
     void updateGL();
+    void setViewRotation(double degrees, double x, double y); // поворот вида вокруг оси (x, y, 0)
   };
 }
 
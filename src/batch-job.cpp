@@ -0,0 +1,127 @@
+﻿#include <batch-job.h>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QFileInfo>
+#include <QImage>
+#include <QFile>
+#include <QDir>
+
+#include <cylindrical-sweep.h>
+#include <symmetric-points-mover.h>
+#include <default-points-mover.h>
+
+namespace rn {
+  BatchJob::BatchJob() :
+    succeeded(false)
+  {
+
+  }
+
+  BatchJob::BatchJob(const QString& input, const QString& output) :
+    input(input),
+    output(output),
+    succeeded(false)
+  {
+
+  }
+
+  bool BatchJob::run() {
+    succeeded = false;
+
+    QFile file(input);
+    if (!file.open(QIODevice::ReadOnly)) {
+      error = "can't open " + input;
+      return false;
+    }
+
+    QJsonParseError parse_error;
+    auto document = QJsonDocument::fromJson(file.readAll(), &parse_error);
+    if (parse_error.error != QJsonParseError::NoError || !document.isObject()) {
+      error = input + ": " + parse_error.errorString();
+      return false;
+    }
+
+    auto root = document.object();
+    auto image_path = QFileInfo(input).dir().filePath(root["image"].toString());
+    QImage image(image_path);
+    if (image.isNull()) {
+      error = "can't load image " + image_path;
+      return false;
+    }
+
+    // сцена совпадает с изображением, ее центр - центр изображения
+    Session::HardPtr session(new Session(image));
+    session->screen_size = vec2i(image.width(), image.height());
+    session->offsets = vec2i(0, 0);
+    session->slices = root["slices"].toInt(16);
+    session->tolerance = root["tolerance"].toInt(0);
+
+    int step = root["step"].toInt(4);
+    if (step <= 0 || session->slices < 3) {
+      error = input + ": invalid 'step' or 'slices'";
+      return false;
+    }
+
+    CylindricalSweep sweep;
+    sweep.setSessionData(session);
+    if (root["mode"].toString() == "symmetric") {
+      sweep.setPointsMover(std::make_shared<SymmetricPointsMover>());
+    }
+    else {
+      sweep.setPointsMover(std::make_shared<DefaultPointsMover>());
+    }
+
+    auto texturing = root["texturing"].toString("none");
+    sweep.using_texturing = texturing != "none";
+    sweep.texturing_mode = texturing == "cyclically" ? CylindricalSweep::Cyclically : CylindricalSweep::Mirror;
+
+    vec2i center = session->screenCenter();
+    auto to_point = [&center](const QJsonValue& value, vec2i& point) {
+      auto coords = value.toArray();
+      if (coords.size() != 2) return false;
+
+      point = vec2i(coords[0].toInt(), coords[1].toInt()) - center; // СК сцены
+      return true;
+    };
+
+    auto objects = root["objects"].toArray();
+    for (int i = 0; i < objects.size(); ++i) {
+      auto object = objects[i].toObject();
+      auto basis_points = object["basis"].toArray();
+
+      AnchorLayer basis;
+      vec2i target;
+      bool correct = basis_points.size() == 3 && to_point(object["sweep"], target);
+      for (int j = 0; correct && j < 3; ++j) {
+        correct = to_point(basis_points[j], basis[j]);
+      }
+
+      if (!correct) {
+        error = input + QString(": invalid object #%1").arg(i);
+        return false;
+      }
+
+      session->step = step; // направление протягивания для каждого объекта определяется заново
+      sweep.reset();
+      sweep.defInclinationAngle(basis[0], basis[1]);
+      sweep.start(basis);
+      sweep.extendTo(target);
+
+      session->addMesh(sweep.createMeshFromLayers(CylindricalSweep::thin(sweep.layers(), session->tolerance)));
+    }
+
+    if (session->scene.isEmpty()) {
+      error = input + ": no objects";
+      return false;
+    }
+
+    if (!Mesh::saveScene(session->scene.meshes(), output.toLocal8Bit().data(), image)) {
+      error = "can't write " + output;
+      return false;
+    }
+
+    succeeded = true;
+    return true;
+  }
+}
@@ -0,0 +1,182 @@
+﻿#include <box-tree.h>
+#include <algorithm>
+#include <defs.h>
+
+namespace rn {
+  BoxTree::Box::Box() :
+    min(Int::max(), Int::max()),
+    max(Int::min(), Int::min())
+  {
+
+  }
+
+  BoxTree::Box::Box(const vec2i& min, const vec2i& max) :
+    min(min),
+    max(max)
+  {
+
+  }
+
+  bool BoxTree::Box::isEmpty() const {
+    return min.x > max.x || min.y > max.y;
+  }
+
+  bool BoxTree::Box::contains(const vec2i& point) const {
+    return point.x >= min.x && point.x <= max.x && point.y >= min.y && point.y <= max.y;
+  }
+
+  bool BoxTree::Box::contains(const Box& box) const {
+    return box.min.x >= min.x && box.max.x <= max.x && box.min.y >= min.y && box.max.y <= max.y;
+  }
+
+  bool BoxTree::Box::intersects(const Box& box) const {
+    return max.x >= box.min.x && min.x <= box.max.x && max.y >= box.min.y && min.y <= box.max.y;
+  }
+
+  BoxTree::Box BoxTree::Box::united(const Box& box) const {
+    return Box(vec2i(std::min(min.x, box.min.x), std::min(min.y, box.min.y)),
+               vec2i(std::max(max.x, box.max.x), std::max(max.y, box.max.y)));
+  }
+
+  BoxTree::BoxTree() :
+    offset_(0, 0),
+    flip_x_(1)
+  {
+
+  }
+
+  BoxTree::BoxTree(const QVector<Box>& boxes) :
+    BoxTree()
+  {
+    if (boxes.isEmpty()) return;
+
+    QVector<int> items(boxes.size());
+    for (int i = 0; i < items.size(); ++i) {
+      items[i] = i;
+    }
+
+    nodes_.reserve(2 * boxes.size() - 1);
+    leaves_.resize(boxes.size());
+    build(items, 0, items.size(), boxes, -1);
+  }
+
+  int BoxTree::build(QVector<int>& items, int begin, int end, const QVector<Box>& boxes, int parent) {
+    int index = nodes_.size();
+    nodes_.push_back(Node());
+    nodes_[index].parent = parent;
+
+    if (end - begin == 1) {
+      nodes_[index].box = boxes[items[begin]];
+      nodes_[index].first = items[begin];
+      nodes_[index].second = -1;
+      leaves_[items[begin]] = index;
+      return index;
+    }
+
+    // делим пополам по медиане центров вдоль длинной стороны
+    Box box;
+    for (int i = begin; i < end; ++i) {
+      box = box.united(boxes[items[i]]);
+    }
+
+    bool by_x = box.max.x - box.min.x >= box.max.y - box.min.y;
+    auto center = [&boxes, by_x](int item) {
+      auto& e = boxes[item];
+      return by_x ? e.min.x + e.max.x : e.min.y + e.max.y;
+    };
+
+    int middle = begin + (end - begin) / 2;
+    std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end, [&center](int a, int b) {
+      return center(a) < center(b);
+    });
+
+    int first = build(items, begin, middle, boxes, index);
+    int second = build(items, middle, end, boxes, index);
+
+    nodes_[index].box = box;
+    nodes_[index].first = first;
+    nodes_[index].second = second;
+    return index;
+  }
+
+  int BoxTree::size() const {
+    return leaves_.size();
+  }
+
+  bool BoxTree::isEmpty() const {
+    return leaves_.isEmpty();
+  }
+
+  size_t BoxTree::memoryUsage() const {
+    return sizeof(*this) + nodes_.capacity() * sizeof(Node) + leaves_.capacity() * sizeof(int);
+  }
+
+  BoxTree::Box BoxTree::toLocal(const Box& box) const {
+    if (box.isEmpty()) return box;
+
+    int x1 = (box.min.x - offset_.x) * flip_x_, x2 = (box.max.x - offset_.x) * flip_x_;
+    return Box(vec2i(std::min(x1, x2), box.min.y - offset_.y), vec2i(std::max(x1, x2), box.max.y - offset_.y));
+  }
+
+  BoxTree::Box BoxTree::toGlobal(const Box& box) const {
+    if (box.isEmpty()) return box;
+
+    int x1 = flip_x_ * box.min.x + offset_.x, x2 = flip_x_ * box.max.x + offset_.x;
+    return Box(vec2i(std::min(x1, x2), box.min.y + offset_.y), vec2i(std::max(x1, x2), box.max.y + offset_.y));
+  }
+
+  BoxTree::Box BoxTree::bounds() const {
+    return isEmpty() ? Box() : toGlobal(nodes_[0].box);
+  }
+
+  void BoxTree::update(int item, const Box& box) {
+    Q_ASSERT(item >= 0 && item < leaves_.size());
+
+    int index = leaves_[item];
+    nodes_[index].box = toLocal(box);
+    for (index = nodes_[index].parent; index >= 0; index = nodes_[index].parent) {
+      auto& node = nodes_[index];
+      auto united = nodes_[node.first].box.united(nodes_[node.second].box);
+      if (node.box.contains(united) && united.contains(node.box)) break; // выше ничего не меняется
+
+      node.box = united;
+    }
+  }
+
+  void BoxTree::move(const vec2i& diff) {
+    offset_ += diff;
+  }
+
+  void BoxTree::mirror(int anchor) {
+    flip_x_ = -flip_x_;
+    offset_.x = 2 * anchor - offset_.x;
+  }
+
+  QVector<int> BoxTree::find(const vec2i& point) const {
+    return find(Box(point, point));
+  }
+
+  QVector<int> BoxTree::find(const Box& global_area) const {
+    auto area = toLocal(global_area);
+
+    QVector<int> found;
+    if (isEmpty() || !nodes_[0].box.intersects(area)) return found;
+
+    QVector<int> stack;
+    stack.push_back(0);
+    while (!stack.isEmpty()) {
+      auto& node = nodes_[stack.back()];
+      stack.pop_back();
+
+      if (node.second < 0) {
+        found.push_back(node.first);
+        continue;
+      }
+
+      if (nodes_[node.first].box.intersects(area)) stack.push_back(node.first);
+      if (nodes_[node.second].box.intersects(area)) stack.push_back(node.second);
+    }
+
+    return found;
+  }
+}
@@ -0,0 +1,96 @@
+﻿#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QtConcurrent>
+#include <QThreadPool>
+#include <QFileInfo>
+#include <QMutex>
+#include <QDir>
+#include <cstdio>
+
+#include <batch-job.h>
+#include <timer.h>
+
+// Пакетная реконструкция: 3d-reconstruction-cli [-o <каталог>] [-f obj|ply|stl|glb] [-j <потоки>] <описание.json | каталог>...
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("3d-reconstruction-cli");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Reconstructs models from images described by JSON files.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("inputs", "JSON descriptions or directories containing them.", "<inputs...>");
+
+  QCommandLineOption output_option(QStringList() << "o" << "output", "Directory for the resulting models (next to inputs by default).", "dir");
+  QCommandLineOption format_option(QStringList() << "f" << "format", "Output format: obj, ply, stl or glb (obj by default).", "format", "obj");
+  QCommandLineOption jobs_option(QStringList() << "j" << "jobs", "Number of worker threads (all cores by default).", "count");
+  parser.addOption(output_option);
+  parser.addOption(format_option);
+  parser.addOption(jobs_option);
+  parser.process(app);
+
+  if (parser.positionalArguments().isEmpty()) {
+    parser.showHelp(1);
+  }
+
+  QString output_dir = parser.value(output_option);
+  if (!output_dir.isEmpty() && !QDir().mkpath(output_dir)) {
+    std::fprintf(stderr, "can't create %s\n", qPrintable(output_dir));
+    return 1;
+  }
+
+  QString format = parser.value(format_option).toLower();
+  if (format != "obj" && format != "ply" && format != "stl" && format != "glb") {
+    std::fprintf(stderr, "unknown format %s\n", qPrintable(format));
+    return 1;
+  }
+
+  QList<rn::BatchJob> jobs;
+  auto add_job = [&](const QFileInfo& info) {
+    QDir dir = output_dir.isEmpty() ? info.dir() : QDir(output_dir);
+    jobs.push_back(rn::BatchJob(info.filePath(), dir.filePath(info.completeBaseName() + "." + format)));
+  };
+
+  for (auto& input : parser.positionalArguments()) {
+    QFileInfo info(input);
+    if (info.isDir()) {
+      for (auto& entry : QDir(input).entryInfoList(QStringList() << "*.json", QDir::Files, QDir::Name)) {
+        add_job(entry);
+      }
+    }
+    else {
+      add_job(info);
+    }
+  }
+
+  if (parser.isSet(jobs_option)) {
+    QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(jobs_option).toInt()));
+  }
+
+  QMutex output_mutex;
+  int finished = 0;
+  ip::Timer timer;
+
+  // каждое изображение обрабатывается независимо - распределяем их по ядрам
+  QtConcurrent::blockingMap(jobs, [&](rn::BatchJob& job) {
+    job.run();
+
+    QMutexLocker locker(&output_mutex);
+    ++finished;
+    if (job.succeeded) {
+      std::printf("[%d/%d] %s -> %s\n", finished, jobs.size(), qPrintable(job.input), qPrintable(job.output));
+    }
+    else {
+      std::fprintf(stderr, "[%d/%d] %s: %s\n", finished, jobs.size(), qPrintable(job.input), qPrintable(job.error));
+    }
+    std::fflush(stdout);
+  });
+
+  int failed = 0;
+  for (auto& job : jobs) {
+    if (!job.succeeded) ++failed;
+  }
+
+  std::printf("%d of %d succeeded in %lld ms\n", jobs.size() - failed, jobs.size(), timer.toc());
+  return failed ? 2 : 0;
+}
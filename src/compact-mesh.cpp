@@ -0,0 +1,62 @@
+﻿#include <compact-mesh.h>
+#include <algorithm>
+#include <cmath>
+
+namespace rn {
+  int CompactMesh::sideTriangles() const {
+    return static_cast<int>(indices.size()) - top_triangles - bottom_triangles;
+  }
+
+  size_t CompactMesh::memoryUsage() const {
+    return sizeof(CompactMesh) +
+      positions.capacity() * sizeof(vec3f) +
+      indices.capacity() * sizeof(indices[0]) +
+      normals.capacity() * sizeof(uint32_t) +
+      tex_coord.capacity() * sizeof(vec2f) +
+      anchors.capacity() * sizeof(vec2i) +
+      layers.capacity() * sizeof(int) +
+      rims.capacity() * sizeof(uint32_t);
+  }
+
+  namespace {
+    inline double signNotZero(double v) {
+      return v < 0.0 ? -1.0 : 1.0;
+    }
+
+    inline uint16_t toSnorm16(double v) {
+      return static_cast<uint16_t>(static_cast<int16_t>(std::lround(std::max(-1.0, std::min(1.0, v)) * 32767.0)));
+    }
+
+    inline double fromSnorm16(uint16_t v) {
+      return std::max(-1.0, static_cast<int16_t>(v) / 32767.0);
+    }
+  }
+
+  uint32_t encodeNormal(const vec3d& n) {
+    double l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 == 0.0) return 0;
+
+    double u = n.x / l1, v = n.y / l1;
+    if (n.z < 0.0) { // нижняя половина октаэдра отражается на углы квадрата
+      double t = u;
+      u = (1.0 - std::abs(v)) * signNotZero(t);
+      v = (1.0 - std::abs(t)) * signNotZero(v);
+    }
+
+    return uint32_t(toSnorm16(u)) | (uint32_t(toSnorm16(v)) << 16);
+  }
+
+  vec3f decodeNormal(uint32_t code) {
+    double u = fromSnorm16(uint16_t(code & 0xFFFF)), v = fromSnorm16(uint16_t(code >> 16));
+    double z = 1.0 - std::abs(u) - std::abs(v);
+    if (z < 0.0) {
+      double t = u;
+      u = (1.0 - std::abs(v)) * signNotZero(t);
+      v = (1.0 - std::abs(t)) * signNotZero(v);
+    }
+
+    double length = std::sqrt(u*u + v*v + z*z);
+    if (length == 0.0) return vec3f(0, 0, 0);
+    return vec3f(float(u / length), float(v / length), float(z / length));
+  }
+}
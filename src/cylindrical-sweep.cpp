@@ -0,0 +1,409 @@
+﻿#include <cylindrical-sweep.h>
+#include <default-points-mover.h>
+#include <ellipse-creator.h>
+#include <point-kernels.h>
+#include <algebra.h>
+#include <line.h>
+#include <aabb.h>
+#include <QtMath>
+#include <QHash>
+
+namespace rn {
+  CylindricalSweep::CylindricalSweep() :
+    inclination_angle_(0.0),
+    rotation_angle_(0.0),
+    points_mover_(new DefaultPointsMover()),
+    texturing_mode(Mirror),
+    using_texturing(false)
+  {
+
+  }
+
+  void CylindricalSweep::setSessionData(rn::Session::HardPtr data) {
+    data_ = data;
+  }
+
+  void CylindricalSweep::setPointsMover(std::shared_ptr<PointsMover> mover) {
+    points_mover_ = mover;
+    if (data_) {
+      updateMover();
+    }
+  }
+
+  CylindricalSweep CylindricalSweep::detached() const {
+    Q_ASSERT(data_);
+
+    CylindricalSweep dst(*this);
+    dst.data_ = data_->snapshot();
+    dst.points_mover_ = points_mover_->clone(); // поля градиента только читаются - остаются общими
+    return dst;
+  }
+
+  void CylindricalSweep::reset() {
+    layers_.clear();
+    rotation_angle_ = 0.0;
+    inclination_angle_ = 0.0;
+    basis_.fill(vec2i(0, 0));
+  }
+
+  void CylindricalSweep::defInclinationAngle(const vec2i& first, const vec2i& second) {
+    inclination_angle_ = vec2d::i.angle((second - first).to<double>());
+    if (second.y < first.y) {
+      inclination_angle_ = -inclination_angle_;
+    }
+
+    if (std::abs(inclination_angle_) > math::Pi_2) {
+      inclination_angle_ -= math::Pi * math::sign(static_cast<int>(inclination_angle_));
+    }
+  }
+
+  void CylindricalSweep::start(const AnchorLayer& basis) {
+    Q_ASSERT(data_);
+
+    basis_ = basis;
+
+    /* Определяем кручение эллипса */
+    double a = (basis_[0] - basis_[1]).length();
+    double b = Line<int>(basis_[0], basis_[1]).dist(basis_[2]);
+    rotation_angle_ = qAbs(math::Pi_2 - qAcos(b / (a * 0.5)));
+
+    layers_.clear();
+    layers_.push_back(basis_);
+
+    updateMover();
+    toSpecify(layers_.back());
+  }
+
+  bool CylindricalSweep::extendTo(const vec2i& target, const std::atomic_bool* cancel) {
+    Q_ASSERT(!layers_.isEmpty());
+
+    layers_.resize(1);
+    auto layer = layers_.back();
+    double dist = Line<int>(layer[0], layer[1]).dist(target);
+
+    // габариты всех слоев поддерживаются по мере добавления (слои лишь дописываются в конец),
+    // а не пересчитываются по всем слоям на каждом шаге
+    QPair<vec2i, vec2i> box {
+      vec2i(Int::max(), Int::max()),
+          vec2i(Int::min(), Int::min())
+    };
+    auto extend_box = [&box](const AnchorLayer& layer) {
+      for (auto& point : layer) {
+        box.first.x = qMin(box.first.x, point.x);
+        box.first.y = qMin(box.first.y, point.y);
+        box.second.x = qMax(box.second.x, point.x);
+        box.second.y = qMax(box.second.y, point.y);
+      }
+    };
+    auto calc_square = [](const QPair<vec2i, vec2i>& area) {
+      return qAbs((area.second.x - area.first.x) * (area.second.y - area.first.y));
+    };
+
+    extend_box(layers_.front());
+    int prev_square = calc_square(box);
+    while (std::abs(dist) >= std::abs(data_->step)) {
+      if (cancel && *cancel) {
+        return false;
+      }
+
+      correctStep(target);
+
+      auto layer = layers_.back();
+      auto n = Line<int>(basis_[0], basis_[1]).normal().to<double>().normalize();
+
+      toSpecify(layer, n, data_->step);
+      if ((layer[0] - layer[1]).length() < 1.0) {
+        break; // слой выродился в точку
+      }
+
+      layer[2] = layer[0] + (basis_[2] - basis_[0]);
+      layers_.push_back(layer);
+
+      extend_box(layer);
+      int square = calc_square(box);
+      if (prev_square == square) { // габариты не изменились - что-то не так
+        layers_.pop_back(); // последний слой ничего не изменил, отбросим его
+        break;
+      }
+
+      prev_square = square;
+      dist = Line<int>(layer[0], layer[1]).dist(target);
+    }
+
+    return true;
+  }
+
+  double CylindricalSweep::distTo(const vec2i& target) const {
+    Q_ASSERT(!layers_.isEmpty());
+
+    auto& points = layers_.back();
+    return Line<int>(points[0], points[1]).dist(target);
+  }
+
+  double CylindricalSweep::inclinationAngle() const {
+    return inclination_angle_;
+  }
+
+  double CylindricalSweep::rotationAngle() const {
+    return rotation_angle_;
+  }
+
+  int CylindricalSweep::step() const {
+    return data_->step;
+  }
+
+  const AnchorLayers& CylindricalSweep::layers() const {
+    return layers_;
+  }
+
+  void CylindricalSweep::setLayers(const AnchorLayers& layers) {
+    Q_ASSERT(!layers.isEmpty());
+    layers_ = layers;
+  }
+
+  void CylindricalSweep::correctStep(const vec2i& target) {
+    auto layer = layers_.back();
+    auto line = Line<int>(layer[0], layer[1]);
+    auto n = line.normal().to<double>().normalize() * static_cast<double>(data_->step);
+    vec2d other = (target - layers_.back()[0]).to<double>();
+    if (n.angle(other) > math::Pi_2) {
+      data_->invertStep();
+    }
+  }
+
+  void CylindricalSweep::updateMover() {
+    points_mover_->setLookAhead(false);
+    points_mover_->setGradient(data_->gvf);
+    points_mover_->setGradientDir(data_->gvf_dir);
+    points_mover_->setPrevLayers(layers_);
+  }
+
+  void CylindricalSweep::toSpecify(AnchorLayer& points, vec2d normal, double length, vec2d* dir) {
+    // нужен для пересчета сцены модели в координаты изображения, где (0, 0) - в нижнем левом углу
+    vec2i offset = data_->screenCenter() - data_->offsets;
+
+    vec2d change_dir;
+    if (!dir) {
+      change_dir = (points[0] - points[1]).to<double>().normalize();
+    }
+
+    points_mover_->setChangeDir(change_dir);
+    points_mover_->setGrowthDir(normal);
+    points_mover_->setGrowthLength(length);
+    points_mover_->setOffset(offset);
+    points_mover_->setLookAhead(true);
+
+    points_mover_->move(points);
+  }
+
+  AnchorLayers CylindricalSweep::thin(const AnchorLayers& layers, double tolerance) {
+    if (tolerance <= 0.0 || layers.size() < 3) {
+      return layers;
+    }
+
+    // отклонение слоя k от интерполяции между слоями from и to
+    auto deviation = [&layers](int from, int to, int k) {
+      double t = double(k - from) / (to - from);
+      double dst = 0.0;
+      for (size_t p = 0; p < layers[k].size(); ++p) {
+        vec2d expected = layers[from][p].to<double>() * (1.0 - t) + layers[to][p].to<double>() * t;
+        dst = qMax(dst, (layers[k][p].to<double>() - expected).length());
+      }
+      return dst;
+    };
+
+    // пропуск ограничен, иначе на длинном прямом участке каждый новый слой перепроверял бы все пропущенные
+    const int max_span = 64;
+
+    AnchorLayers dst;
+    dst.push_back(layers.front());
+    for (int from = 0, to = 2; to < layers.size(); ++to) {
+      if (to - from > max_span) {
+        from = to - 1;
+        dst.push_back(layers[from]);
+        continue;
+      }
+
+      for (int k = from + 1; k < to; ++k) {
+        if (deviation(from, to, k) > tolerance) {
+          from = to - 1; // дотянуться можно только до предыдущего слоя, он остается
+          dst.push_back(layers[from]);
+          break;
+        }
+      }
+    }
+
+    dst.push_back(layers.back());
+    return dst;
+  }
+
+  Mesh::HardPtr CylindricalSweep::createMeshFromLayers(const AnchorLayers& layers) {
+    Mesh::HardPtr mesh(new Mesh());
+    auto ellipses = createLayersPoints(layers);
+    for (auto& ellipse : ellipses) {
+      mesh->addLayer(ellipse);
+    }
+
+    if (using_texturing) {
+      mesh->addTexCoords(defTexCoords(ellipses, layers));
+    }
+
+    mesh->updateNormals();
+    mesh->anchor_points = layers;
+    return mesh;
+  }
+
+  void CylindricalSweep::recreate(Mesh::HardPtr mesh, const AnchorLayers& anchor_points) {
+    mesh->bake(); // слои строятся в координатах сцены, крышки должны быть в них же
+    Mesh::HardPtr new_mesh(mesh->clone());
+    new_mesh->vertices.clear();
+    new_mesh->tex_coord.clear();
+    auto ellipses = createLayersPoints(anchor_points);
+    for (auto& ellipse : ellipses) {
+      new_mesh->addLayer(ellipse);
+    }
+
+    if (using_texturing) {
+      new_mesh->addTexCoords(defTexCoords(ellipses, anchor_points));
+    }
+
+    new_mesh->updateNormals();
+    new_mesh->anchor_points = anchor_points;
+
+    new_mesh->top_cover = mesh->top_cover;
+    new_mesh->bottom_cover = mesh->bottom_cover;
+    new_mesh->updateNormals();
+    mesh->swap(new_mesh.get());
+  }
+
+  QVector<vec3i> CylindricalSweep::createLayerPoints(const AnchorLayer& key_points) {
+    return createLayersPoints(AnchorLayers() << key_points).front();
+  }
+
+  QVector<QVector<vec3i>> CylindricalSweep::createLayersPoints(const AnchorLayers& layers) {
+    Q_ASSERT(data_);
+
+    QVector<int> radii;
+    radii.reserve(layers.size());
+    int max_radius = 0;
+    for (auto& key_points : layers) {
+      radii.push_back(int((key_points[0] - key_points[1]).length() / 2));
+      max_radius = qMax(max_radius, radii.back());
+    }
+
+    // единичная окружность строится в плоскости OXZ и поворачивается один раз на каждое встретившееся
+    // число точек, каждый слой - масштаб на его радиус и перенос в центр
+    QHash<int, Points3d> units;
+    auto rotation = mat3d::rotZ(-inclination_angle_);
+
+    QVector<QVector<vec3i>> dst;
+    dst.reserve(layers.size());
+    for (int l = 0; l < layers.size(); ++l) {
+      auto& key_points = layers[l];
+      vec3i center((key_points[0] + key_points[1]) / 2, ProjectionPlane::OXY);
+      int a = radii[l];
+
+      int count = layerSlices(a, max_radius);
+      if (!units.contains(count)) {
+        auto circle = unitCircle(count);
+        Points3d unit(count);
+        for (int i = 0; i < count; ++i) {
+          unit.x[i] = circle[i].x;
+          unit.z[i] = circle[i].y;
+        }
+        kernels::transform(unit, rotation, unit);
+        units.insert(count, unit);
+      }
+
+      auto& unit = units[count];
+      QVector<vec3i> ellipse(count);
+      for (int i = 0; i < count; ++i) {
+        ellipse[i] = vec3i(int(a*unit.x[i]), int(a*unit.y[i]), int(a*unit.z[i])) + center;
+      }
+      dst.push_back(ellipse);
+    }
+
+    return dst;
+  }
+
+  int CylindricalSweep::layerSlices(int radius, int max_radius) const {
+    int slices = data_->slices;
+    int min_slices = qMin(slices, 4);
+    if (radius >= max_radius) {
+      return slices;
+    }
+
+    // слой не грубее самого большого: отклонение многоугольника от окружности (стрелка сегмента)
+    // не больше, чем у самого большого слоя при полном числе точек
+    double sagitta = max_radius * (1.0 - qCos(math::Pi / slices));
+    if (radius <= sagitta) {
+      return min_slices;
+    }
+
+    return qBound(min_slices, qCeil(math::Pi / qAcos(1.0 - sagitta / radius)), slices);
+  }
+
+  QVector<vec2i> CylindricalSweep::createEllipseByThreePoints(const AnchorLayer& points) const {
+    Q_ASSERT(data_);
+
+    int a = (points[0] - points[1]).length() / 2; // главная полуось
+    int b = Line<int>(points[0], points[1]).dist(points[2]); // малая полуось
+
+    EllipseCreator<int> creator(a, b);
+    creator.setAngle(inclination_angle_);
+    creator.setCenter((points[0] + points[1]) / 2);
+    return creator.create(data_->slices);
+  }
+
+  QVector<vec2d> CylindricalSweep::defTexCoords(const QVector<QVector<vec3i>>& ellipses, const AnchorLayers& bases) const {
+    Q_ASSERT(ellipses.size() == bases.size());
+
+    vec2i offset = data_->screenCenter() - data_->offsets;
+    double width = data_->width(), height = data_->height();
+
+    int total = 0;
+    for (auto& ellipse : ellipses) {
+      total += ellipse.size();
+    }
+
+    // точки всех слоев подряд, относительно центра своего слоя; каждый слой закручивается
+    // вокруг своей оси одним преобразованием
+    Points3d points(total);
+    QVector<vec3i> centers;
+    centers.reserve(ellipses.size());
+    for (int l = 0, from = 0; l < ellipses.size(); from += ellipses[l].size(), ++l) {
+      auto& src = ellipses[l];
+      auto& base = bases[l];
+      auto axis = vec3d((base[0] - base[1]).to<double>(), ProjectionPlane::OXY, 0).normalize();
+
+      vec3i center = createAABB<int>(src.begin(), src.end()).center();
+      for (int i = 0; i < src.size(); ++i) {
+        points.x[from + i] = src[i].x - center.x;
+        points.y[from + i] = src[i].y - center.y;
+        points.z[from + i] = src[i].z - center.z;
+      }
+
+      kernels::transform(points, mat3d::rotation(rn::abs(axis), rotation_angle_), points, from, src.size());
+      centers.push_back(center);
+    }
+
+    QVector<vec2d> uv(total);
+    for (int l = 0, from = 0; l < ellipses.size(); from += ellipses[l].size(), ++l) {
+      int count = ellipses[l].size(), T = count / 2;
+      auto& center = centers[l];
+      for (int i = 0; i < count; ++i) {
+        // точки слоя после закручивания - целые, как и вершины модели
+        int j = i;
+        if (texturing_mode == Cyclically && int(points.z[from + i]) + center.z < 0) {
+          j = (i + T) % count; // продолжаем циклически, а не отражаем зеркально
+        }
+
+        double ex = int(points.x[from + j]) * 0.98 + center.x;
+        double ey = int(points.y[from + j]) * 0.98 + center.y;
+        uv[from + i] = vec2d((ex + offset.x) / width, 1.0 - (ey + offset.y) / height);
+      }
+    }
+
+    return uv;
+  }
+}
@@ -4,7 +4,7 @@
 
 #include <algebra.h>
 
-void DefaultPointsMover::move(QVector<vec2i>& points)  {
+void DefaultPointsMover::move(rn::AnchorLayer& points)  {
   // TODO Проверять параметры - заданы ли нужные
 
   for (int index = 0; index < 2/*points.size()*/; ++index) {
@@ -47,3 +47,7 @@ void DefaultPointsMover::move(QVector<vec2i>& points)  {
     point -= offset_;
   }
 }
+
+std::shared_ptr<PointsMover> DefaultPointsMover::clone() const {
+  return std::make_shared<DefaultPointsMover>(*this);
+}
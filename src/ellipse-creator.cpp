@@ -0,0 +1,26 @@
+﻿#include <ellipse-creator.h>
+#include <QMutex>
+#include <QHash>
+#include <defs.h>
+
+namespace rn {
+  QVector<vec2d> unitCircle(int count) {
+    static QMutex mutex; // таблицы нужны и пакетной обработке, которая строит модели в нескольких потоках
+    static QHash<int, QVector<vec2d>> tables;
+
+    QMutexLocker locker(&mutex);
+    auto it = tables.find(count);
+    if (it != tables.end()) {
+      return it.value();
+    }
+
+    QVector<vec2d> circle(count);
+    for (int i = 0; i < count; ++i) {
+      double angle = 2.0 * math::Pi * i / count; // без накопления шага - ровно count точек
+      circle[i] = vec2d(cos(angle), sin(angle));
+    }
+
+    tables.insert(count, circle);
+    return circle;
+  }
+}
@@ -0,0 +1,145 @@
+﻿#include <history.h>
+
+namespace rn {
+  History::History(size_t budget) :
+    budget_(budget),
+    footprint_(0)
+  {
+
+  }
+
+  void History::hold(const Scene& scene) {
+    footprint_ += scene.size() * sizeof(Mesh::HardPtr);
+    for (auto& mesh : scene) {
+      if (++refs_[mesh.get()] > 1 || alive_.contains(mesh.get())) continue;
+
+      // модель вне текущей сцены занимает свой объект, а ее геометрия - если она нигде больше не учтена
+      footprint_ += sizeof(Mesh);
+      auto id = mesh->geometryId();
+      if (alive_geometry_.contains(id)) continue;
+
+      auto it = geometry_.find(id);
+      if (it == geometry_.end()) {
+        Geometry geometry = { 1, mesh->memoryUsage() - sizeof(Mesh) };
+        geometry_.insert(id, geometry);
+        footprint_ += geometry.bytes;
+      }
+      else {
+        ++it.value().meshes;
+      }
+    }
+  }
+
+  void History::drop(const Scene& scene) {
+    footprint_ -= scene.size() * sizeof(Mesh::HardPtr);
+    for (auto& mesh : scene) {
+      auto it = refs_.find(mesh.get());
+      if (--it.value() > 0) continue;
+
+      refs_.erase(it);
+      if (alive_.contains(mesh.get())) continue;
+
+      footprint_ -= sizeof(Mesh);
+      auto geometry = geometry_.find(mesh->geometryId());
+      if (geometry != geometry_.end() && --geometry.value().meshes == 0) {
+        footprint_ -= geometry.value().bytes;
+        geometry_.erase(geometry);
+      }
+    }
+  }
+
+  bool History::changed(const Scene& current) const {
+    if (current.size() != current_.size()) return true;
+
+    for (int i = 0; i < current.size(); ++i) {
+      auto& mesh = current[i];
+      if (current_[i].first != mesh.get() || current_[i].second != mesh->geometryId()) return true;
+    }
+
+    return false;
+  }
+
+  void History::recount(const Scene& current) {
+    current_.clear();
+    alive_.clear();
+    alive_geometry_.clear();
+    for (auto& mesh : current) {
+      current_.push_back(qMakePair<const Mesh*, quint64>(mesh.get(), mesh->geometryId()));
+      alive_.insert(mesh.get());
+      alive_geometry_.insert(mesh->geometryId());
+    }
+
+    // ссылки и учет памяти строятся заново по всем состояниям
+    refs_.clear();
+    geometry_.clear();
+    footprint_ = 0;
+    for (auto& state : states_) {
+      hold(state);
+    }
+  }
+
+  void History::evict() {
+    // освобождаемая память вычитается в drop, поэтому вытеснение - один проход
+    while (footprint_ > budget_ && !states_.isEmpty()) {
+      drop(states_.front());
+      states_.pop_front();
+    }
+  }
+
+  void History::setBudget(size_t bytes) {
+    budget_ = bytes;
+  }
+
+  size_t History::budget() const {
+    return budget_;
+  }
+
+  void History::update(const Scene& current) {
+    if (changed(current)) {
+      recount(current);
+    }
+
+    evict();
+  }
+
+  void History::push(const Scene& scene, const Scene& current) {
+    states_.push_back(scene);
+    if (changed(current)) {
+      recount(current); // учтет и новое состояние
+    }
+    else {
+      hold(scene);
+    }
+
+    evict();
+  }
+
+  Scene History::pop() {
+    Q_ASSERT(!states_.isEmpty());
+
+    Scene scene = states_.back();
+    states_.pop_back();
+    drop(scene);
+
+    return scene;
+  }
+
+  void History::clear() {
+    states_.clear();
+    refs_.clear();
+    geometry_.clear();
+    footprint_ = 0;
+  }
+
+  int History::size() const {
+    return states_.size();
+  }
+
+  bool History::isEmpty() const {
+    return states_.isEmpty();
+  }
+
+  size_t History::footprint() const {
+    return footprint_;
+  }
+}
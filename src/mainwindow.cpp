@@ -13,6 +13,13 @@
 #include <QTimer>
 #include <QToolBar>
 #include <QComboBox>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QDir>
+#include <queue>
+#include <tuple>
 #include <QAction>
 
 #include <viewport.h>
@@ -63,8 +70,17 @@ MainWindow::MainWindow(QWidget* parent) :
       session_->step = value.toInt();
     }
   });
+  connect(creating_toolbar_.tolerance, &QComboBox::currentTextChanged, [=](const QString& value) {
+    if (session_) {
+      session_->tolerance = value.toInt();
+    }
+  });
 
   connect(model_creator_.get(), &rn::ModelCreator::signalBeforeNewModelCreating, this, &MainWindow::slotBeforeNewModelCreating);
+  connect(model_creator_.get(), &rn::ModelCreator::signalViewRotation, viewport_, &rn::Viewport::setViewRotation);
+  connect(model_creator_.get(), &rn::ModelCreator::signalPreviewChanged, [=]() {
+    viewport_->updateGL();
+  });
 
   connect(viewport_, &rn::Viewport::signalWheelEvent, this, &MainWindow::slotWheelEvent);
   connect(viewport_, &rn::Viewport::signalMouseMoveEvent, this, &MainWindow::slotMouseMoveEvent);
@@ -80,14 +96,14 @@ MainWindow::MainWindow(QWidget* parent) :
   connect(tools_->cursor, &QPushButton::toggled, moving_toolbar_.toolbar, &QToolBar::setVisible);
   connect(tools_->cursor, &QPushButton::clicked, [=](bool checked) {
     if (!checked) {
-      session_->selected_meshes.clear();
+      session_->scene.clearSelection();
       onSelectionChange();
     }
   });
 
   connect(tools_->smooth, &QPushButton::clicked, [=]() {
     if (!session_) return;
-    for (auto mesh : session_->selected_meshes) {
+    for (auto mesh : session_->scene.selectedMeshes()) {
       dynamic_cast<rn::CylindricalModelCreator*>(model_creator_.get())->smoothWithAveraging(mesh);
       viewport_->updateGL();
     }
@@ -95,7 +111,7 @@ MainWindow::MainWindow(QWidget* parent) :
 
   connect(tools_->triangle_first_layer, &QPushButton::clicked, [=](bool) {
     if (!session_) return;
-    for (auto mesh : session_->selected_meshes) {
+    for (auto mesh : session_->scene.selectedMeshes()) {
       mesh->triangulateFirstLayer();
       viewport_->updateGL();
     }
@@ -103,7 +119,7 @@ MainWindow::MainWindow(QWidget* parent) :
 
   connect(tools_->triangle_last_layer, &QPushButton::clicked, [=](bool) {
     if (!session_) return;
-    for (auto mesh: session_->selected_meshes) {
+    for (auto mesh : session_->scene.selectedMeshes()) {
       mesh->triangulateLastLayer();
       viewport_->updateGL();
     }
@@ -239,8 +255,8 @@ void MainWindow::createCreatingToolbar() {
   creating_toolbar_.copy->setEnabled(false);
   connect(creating_toolbar_.copy, &QAction::triggered, [=]() {
     if (session_) {
-      for (auto mesh : session_->selected_meshes) {
-        session_->meshes.push_back(mesh->clone());
+      for (auto mesh : session_->scene.selectedMeshes()) {
+        session_->addMesh(mesh->clone());
       }
     }
   });
@@ -300,6 +316,20 @@ void MainWindow::createCreatingToolbar() {
   creating_toolbar_.slices->setCurrentText("45");
   creating_toolbar_.slices->setFixedWidth(64);
   creating_toolbar_.toolbar->addWidget(creating_toolbar_.slices);
+
+  creating_toolbar_.toolbar->addSeparator();
+
+  auto tolerance_label = new QLabel(ru(" Допуск: "), this);
+  tolerance_label->setFont(QFont("Arial", 13));
+  tolerance_label->setToolTip(ru("Допустимое отклонение (пикс.) при разрежении слоев, 0 - слои на каждом шаге"));
+  creating_toolbar_.toolbar->addWidget(tolerance_label);
+
+  creating_toolbar_.tolerance = new QComboBox(this);
+  creating_toolbar_.tolerance->setFont(QFont("Arial", 13));
+  creating_toolbar_.tolerance->addItems(generate(0, 11));
+  creating_toolbar_.tolerance->setCurrentText("0");
+  creating_toolbar_.tolerance->setFixedWidth(48);
+  creating_toolbar_.toolbar->addWidget(creating_toolbar_.tolerance);
 }
 
 void MainWindow::createMovingToolbar() {
@@ -370,10 +400,28 @@ void MainWindow::createMenuFile() {
   menu_file_.save->setIcon(QIcon("icons/save.png"));
   connect(menu_file_.save, &QAction::triggered, this, &MainWindow::slotSaveMeshes);
 
+  menu_file_.save_ply = menu->addAction(ru("Сохранить в формате PLY"));
+  connect(menu_file_.save_ply, &QAction::triggered, [=]() {
+    saveMeshes("ply");
+  });
+
+  menu_file_.save_stl = menu->addAction(ru("Сохранить в формате STL"));
+  connect(menu_file_.save_stl, &QAction::triggered, [=]() {
+    saveMeshes("stl");
+  });
+
+  menu_file_.save_glb = menu->addAction(ru("Сохранить в формате glTF (с текстурой)"));
+  connect(menu_file_.save_glb, &QAction::triggered, [=]() {
+    saveMeshes("glb");
+  });
+
   menu_file_.save_each = menu->addAction(ru("Сохранить каждую модель в отдельный файл"));
   menu_file_.save_each->setIcon(QIcon("icons/save-each.png"));
   connect(menu_file_.save_each, &QAction::triggered, this, &MainWindow::slotSaveEachMeshes);
 
+  menu_file_.save_each_to_dir = menu->addAction(ru("Сохранить каждую модель в каталог..."));
+  connect(menu_file_.save_each_to_dir, &QAction::triggered, this, &MainWindow::slotSaveEachMeshesToDir);
+
   menu->addSeparator();
 
   auto quit = menu->addAction(ru("Выход"));
@@ -381,7 +429,7 @@ void MainWindow::createMenuFile() {
 }
 
 void MainWindow::onSelectionChange() {
-  if (!session_->selected_meshes.isEmpty()) {
+  if (session_->scene.selectedCount() > 0) {
     creating_toolbar_.copy->setEnabled(true);
     creating_toolbar_.mirror->setEnabled(true);
     creating_toolbar_.unite_meshes->setEnabled(true);
@@ -402,10 +450,20 @@ void MainWindow::openImage(const QString& filename) {
   viewport_->hide_image = false;
   show_image_->setChecked(true);
 
-  viewport_->makeCurrent();
-  session_.reset(new rn::Session(QImage(filename), viewport_));
+  QImage image(filename);
+  if (image.width() > MIN_SCENE_WIDTH * 0.85 || image.height() > MIN_SCENE_HEIGHT * 0.85) {
+    image = image.scaled(MIN_SCENE_WIDTH * 0.85, MIN_SCENE_HEIGHT * 0.85, Qt::KeepAspectRatio);
+  }
+
+  session_.reset(new rn::Session(image));
   session_->slices = creating_toolbar_.slices->currentText().toInt();
   session_->step = creating_toolbar_.step->currentText().toInt();
+  session_->tolerance = creating_toolbar_.tolerance->currentText().toInt();
+
+  // объем памяти под историю отмены, МБ
+  QSettings settings("settings.ini", QSettings::IniFormat);
+  session_->setBackupsBudget(settings.value("undo-memory-mb", 256).toULongLong() * 1024 * 1024);
+
   viewport_->setSession(session_);
   model_creator_->setSessionData(session_);
 
@@ -416,7 +474,7 @@ void MainWindow::openImage(const QString& filename) {
 }
 
 void MainWindow::askAboutSaving() {
-  if (tools_->create->isChecked() && session_ && !session_->meshes.isEmpty()) {
+  if (tools_->create->isChecked() && session_ && !session_->scene.isEmpty()) {
     auto title = ru("Сохранение");
     auto message = ru(
           "Вы хотите сохранить уже созданные модели в файл? "
@@ -439,19 +497,20 @@ QPoint MainWindow::convertToSceneCoord(const QPoint& pos) {
 }
 
 void MainWindow::slotSaveMeshes() {
-  if (!session_) return;
-  Mesh::HardPtr common = session_->meshes.first();
-  for (int i = 1; i < session_->meshes.size(); ++i) {
-    common = Mesh::merge(common, session_->meshes[i]);
-  }
+  saveMeshes("obj");
+}
+
+void MainWindow::saveMeshes(const QString& format) {
+  if (!session_ || session_->scene.isEmpty()) return;
 
   QString default_dir = "/";
   auto caption = ru("Сохранить модель(и) как:");
-  auto path = QFileDialog::getSaveFileName(this, caption, default_dir, ru("Формат OBJ (*.obj);;"));
+  auto filter = ru("Формат %1 (*.%2);;").arg(format.toUpper()).arg(format);
+  auto path = QFileDialog::getSaveFileName(this, caption, default_dir, filter);
   if (path.isEmpty()) return;
 
-  if (!path.endsWith(".obj")) path += ".obj";
-  common->saveAsObj(path.toLocal8Bit().data());
+  if (!path.endsWith("." + format, Qt::CaseInsensitive)) path += "." + format;
+  Mesh::saveScene(session_->scene.meshes(), path.toLocal8Bit().data(), session_->image);
 }
 
 void MainWindow::slotMakeScreenshot() {
@@ -465,21 +524,101 @@ void MainWindow::slotMakeScreenshot() {
 
 void MainWindow::slotSaveEachMeshes() {
   if (!session_) return;
-  for (int i = 0; i < session_->meshes.size(); ++i) {
+  for (int i = 0; i < session_->scene.size(); ++i) {
     QString default_dir = "/";
     auto caption = ru("Сохранить модель #%1 как:").arg(i);
-    auto path = QFileDialog::getSaveFileName(this, caption, default_dir, ru("Формат OBJ (*.obj);;"));
+    auto filter = ru("Формат OBJ (*.obj);;Формат PLY (*.ply);;Формат STL (*.stl);;Формат glTF (*.glb);;");
+    auto path = QFileDialog::getSaveFileName(this, caption, default_dir, filter);
     if (path.isEmpty()) continue;
 
-    if (!path.endsWith(".obj")) path += ".obj";
-    session_->meshes[i]->saveAsObj(path.toLocal8Bit().data());
+    auto suffix = QFileInfo(path).suffix().toLower();
+    if (suffix != "obj" && suffix != "ply" && suffix != "stl" && suffix != "glb") path += ".obj";
+    session_->scene[i]->save(path.toLocal8Bit().data(), session_->image);
   }
 }
 
+void MainWindow::slotSaveEachMeshesToDir() {
+  if (!session_ || session_->scene.isEmpty()) return;
+
+  QSettings settings("settings.ini", QSettings::IniFormat);
+  auto dir = QFileDialog::getExistingDirectory(this, ru("Каталог для моделей:"), settings.value("save-each-dir", "/").toString());
+  if (dir.isEmpty()) return;
+
+  bool ok = false;
+  auto caption = ru("Имена файлов");
+  auto label = ru("Шаблон имени (%1 - номер модели, расширение задает формат: obj, ply, stl, glb):");
+  auto pattern = QInputDialog::getText(this, caption, label, QLineEdit::Normal, settings.value("save-each-pattern", "model-%1.obj").toString(), &ok);
+  if (!ok || !pattern.contains("%1")) return;
+
+  settings.setValue("save-each-dir", dir);
+  settings.setValue("save-each-pattern", pattern);
+
+  auto meshes = session_->scene.meshes();
+  auto image = session_->image;
+  int width = QString::number(meshes.size()).size(); // номера дополняются нулями до одной длины
+
+  QList<QPair<Mesh::HardPtr, QString>> jobs;
+  for (int i = 0; i < meshes.size(); ++i) {
+    jobs.push_back(qMakePair(meshes[i], QDir(dir).filePath(pattern.arg(i + 1, width, 10, QChar('0')))));
+  }
+
+  // Модальный диалог не дает менять модели, пока они сохраняются, но интерфейс продолжает отрисовываться
+  auto progress = new QProgressDialog(ru("Сохранение моделей..."), ru("Отмена"), 0, jobs.size(), this);
+  progress->setWindowModality(Qt::WindowModal);
+  progress->setMinimumDuration(0);
+  progress->setAttribute(Qt::WA_DeleteOnClose);
+
+  auto watcher = new QFutureWatcher<bool>(progress);
+  connect(watcher, &QFutureWatcher<bool>::progressValueChanged, progress, &QProgressDialog::setValue);
+  connect(progress, &QProgressDialog::canceled, watcher, &QFutureWatcher<bool>::cancel);
+  connect(watcher, &QFutureWatcher<bool>::finished, [=]() {
+    int saved = 0;
+    for (int i = 0; i < jobs.size(); ++i) {
+      if (watcher->future().isResultReadyAt(i) && watcher->future().resultAt(i)) ++saved;
+    }
+
+    bool canceled = watcher->isCanceled();
+    progress->close();
+
+    if (canceled) {
+      QMessageBox::information(this, ru("Сохранение"), ru("Сохранение прервано: сохранено %1 из %2 моделей.").arg(saved).arg(jobs.size()));
+    }
+    else if (saved != jobs.size()) {
+      QMessageBox::warning(this, ru("Сохранение"), ru("Не удалось сохранить %1 из %2 моделей.").arg(jobs.size() - saved).arg(jobs.size()));
+    }
+  });
+
+  // каждая модель пишется в свой файл - сохраняем их параллельно в общем пуле потоков
+  std::function<bool(const QPair<Mesh::HardPtr, QString>&)> save = [image](const QPair<Mesh::HardPtr, QString>& job) {
+    return job.first->save(job.second.toLocal8Bit().data(), image);
+  };
+  watcher->setFuture(QtConcurrent::mapped(jobs, save));
+}
+
 void MainWindow::slotUndoLastAction() {
   session_->rollback();
+  // восстановленная сцена возвращает прежние поколения слотов: дескриптор, полученный после сохранения
+  // состояния, мог бы указать на другую модель
+  viewport_->hovered_mesh = rn::Scene::Handle();
   viewport_->updateGL();
-  main_toolbar_.undo->setEnabled(session_->hasBackups());
+  updateUndoAction();
+}
+
+void MainWindow::updateUndoAction() {
+  bool has_backups = session_ && session_->hasBackups();
+  main_toolbar_.undo->setEnabled(has_backups);
+
+  auto tip = ru("Отменить последнее действие");
+  if (has_backups) {
+    double megabytes = session_->backupsFootprint() / (1024.0 * 1024.0);
+    tip += ru(" (шагов: %1, память: %2 МБ)").arg(session_->backupsCount()).arg(megabytes, 0, 'f', 1);
+  }
+  main_toolbar_.undo->setToolTip(tip);
+}
+
+void MainWindow::afterSceneEdit() {
+  session_->updateBackups();
+  updateUndoAction();
 }
 
 void MainWindow::slotOpenImage() {
@@ -512,8 +651,7 @@ void MainWindow::slotChangeCreatingMode(bool checked) {
   if (!session_) return;
 
   if (checked) {
-    session_->meshes.clear();
-    session_->selected_meshes.clear();
+    session_->scene.clear();
   }
   else {
     askAboutSaving();
@@ -536,14 +674,11 @@ void MainWindow::slotMousePressEvent(QMouseEvent* event) {
     else if (event->button() == Qt::LeftButton) { // выделяем отдельные меши
       auto pos = convertToSceneCoord(event->pos());
 
-      session_->selected_meshes.clear();
-      for (auto mesh : session_->meshes) {
-        if (mesh->contains(pos)) {
-          session_->selected_meshes.push_back(mesh);
-        }
-      }
+      // луч учитывает поворот вида, поэтому выбирается именно та модель, что видна под курсором
+      session_->scene.clearSelection();
+      session_->scene.setSelected(session_->pick(viewport_->pickRay(event->pos())));
 
-      if (session_->selected_meshes.isEmpty()) {
+      if (session_->scene.selectedCount() == 0) {
         viewport_->selected_area.push_back(pos);
         viewport_->selected_area.push_back(pos);
       }
@@ -554,13 +689,13 @@ void MainWindow::slotMousePressEvent(QMouseEvent* event) {
       viewport_->updateGL();
     }
     else if (event->button() == Qt::RightButton) { // перемещаем выделенные меши
-      if (!session_->selected_meshes.isEmpty()) {
+      if (session_->scene.selectedCount() > 0) {
         QApplication::setOverrideCursor(QCursor(Qt::SizeAllCursor));
 
         shifts_.clear();
         prev_mouse_ = convertToSceneCoord(event->pos());
         vec3i mouse(prev_mouse_.x(), prev_mouse_.y(), 0);
-        for (auto mesh : session_->selected_meshes) {
+        for (auto mesh : session_->scene.selectedMeshes()) {
           shifts_.push_back(mouse - mesh->center());
         }
       }
@@ -592,11 +727,11 @@ void MainWindow::slotMouseMoveEvent(QMouseEvent* event) {
       }
     }
     else if (event->buttons() & Qt::RightButton) { // перемещаем выделенные меши
-      if (!session_->selected_meshes.isEmpty()) {
+      if (session_->scene.selectedCount() > 0) {
         Q_ASSERT(!shifts_.isEmpty());
         auto current_pos = convertToSceneCoord(event->pos());
         if (prev_mouse_ != current_pos) {
-          for (auto mesh : session_->selected_meshes) {
+          for (auto mesh : session_->scene.selectedMeshes()) {
             auto diff = current_pos - prev_mouse_;
             mesh->move(vec3i(diff.x(), diff.y(), 0));
           }
@@ -606,6 +741,13 @@ void MainWindow::slotMouseMoveEvent(QMouseEvent* event) {
         }
       }
     }
+    else if (event->buttons() == Qt::NoButton && session_) { // подсвечиваем модель под курсором
+      auto hovered = session_->pick(viewport_->pickRay(event->pos()));
+      if (hovered != viewport_->hovered_mesh) {
+        viewport_->hovered_mesh = hovered;
+        viewport_->updateGL();
+      }
+    }
   }
   else if (tools_->create->isChecked()) {
     model_creator_->onMouseMove(event->x(), event->y());
@@ -627,12 +769,10 @@ void MainWindow::slotMouseReleaseEvent(QMouseEvent* event) {
         viewport_->updateGL();
 
         // определим меши, попавшие в область выделения
-        session_->selected_meshes.clear();
         QRect region(viewport_->selected_area[0], viewport_->selected_area[1]);
-        for (auto mesh : session_->meshes) {
-          if (mesh->fallsInto(region)) {
-            session_->selected_meshes.push_back(mesh);
-          }
+        session_->scene.clearSelection();
+        for (auto handle : session_->meshesIn(region)) {
+          session_->scene.setSelected(handle);
         }
 
         onSelectionChange();
@@ -642,22 +782,19 @@ void MainWindow::slotMouseReleaseEvent(QMouseEvent* event) {
       }
     }
     else if (event->button() == Qt::RightButton) { // перемещаем выделенные меши
-      if (!session_->selected_meshes.isEmpty()) {
+      if (session_->scene.selectedCount() > 0) {
         QApplication::restoreOverrideCursor();
         slotBeforeNewModelCreating();
 
-        QList<Mesh::HardPtr> changed_meshes; // нужно для механизма UNDO
+        // меши заменяются копиями (исходные остаются в резервной копии сцены для UNDO),
+        // дескрипторы и выделение при этом сохраняются
         int radius = moving_toolbar_.radius->currentText().toInt();
-        for (auto mesh : session_->selected_meshes) {
-          auto new_mesh = mesh->clone();
-          session_->meshes.removeOne(mesh);
-          changed_meshes.push_back(new_mesh);
+        for (auto handle : session_->scene.selection()) {
+          auto new_mesh = session_->scene.get(handle)->clone();
           model_creator_->place(new_mesh, radius);
-          session_->meshes.push_back(new_mesh);
+          session_->scene.replace(handle, new_mesh);
         }
-
-        // теперь выделенными являются обновленные меши
-        session_->selected_meshes = changed_meshes;
+        afterSceneEdit();
 
         shifts_.clear();
         viewport_->updateGL();
@@ -667,74 +804,93 @@ void MainWindow::slotMouseReleaseEvent(QMouseEvent* event) {
   else if (tools_->create->isChecked() && event->button() == Qt::LeftButton) {
     model_creator_->onMouseMove(event->x(), event->y());
     model_creator_->onMouseRelease(event->button());
+    afterSceneEdit(); // модель могла добавиться в сцену
     viewport_->updateGL();
   }
 }
 
 void MainWindow::slotBeforeNewModelCreating() {
   session_->commit();
-  main_toolbar_.undo->setEnabled(true);
+  updateUndoAction();
 }
 
 void MainWindow::slotMirrorSelectedMeshes() {
   if (!session_) return;
 
-  QList<Mesh::HardPtr> changed_meshes; // нужно для механизма UNDO
+  auto selection = session_->scene.selection();
   int symmetry_axis = 0; // если мешей несколько, то отражать будем по средней оси
-  if (session_->selected_meshes.size() > 1) {
-    for (auto mesh : session_->selected_meshes) {
-      symmetry_axis += mesh->center().x;
+  if (selection.size() > 1) {
+    for (auto handle : selection) {
+      symmetry_axis += session_->scene.get(handle)->center().x;
     }
 
-    symmetry_axis /= session_->selected_meshes.size();
+    symmetry_axis /= selection.size();
   }
 
   slotBeforeNewModelCreating();
-  for (auto mesh : session_->selected_meshes) {
-    auto new_mesh = mesh->clone();
-    session_->meshes.removeOne(mesh);
-
+  for (auto handle : selection) { // копии - для механизма UNDO
+    auto new_mesh = session_->scene.get(handle)->clone();
     new_mesh->mirror(symmetry_axis);
-    changed_meshes.push_back(new_mesh);
-    session_->meshes.push_back(new_mesh);
+    session_->scene.replace(handle, new_mesh);
   }
+  afterSceneEdit();
 
-  // теперь выделенными являются обновленные меши
-  session_->selected_meshes = changed_meshes;
   viewport_->updateGL();
 }
 
 void MainWindow::slotUniteSelectedMeshes() {
   if (!session_) return;
-  if (session_->selected_meshes.size() <= 1) return;
+  if (session_->scene.selectedCount() <= 1) return;
 
   slotBeforeNewModelCreating();
 
-  // сливаем все выбранные меши в один (первым и последним слоями сливаем)
-  while (session_->selected_meshes.size() > 1) {
-    double min_dist = Double::max();
-    QPair<Mesh::HardPtr, Mesh::HardPtr> targets;
-    for (auto e1 : session_->selected_meshes) {
-      for (auto e2 : session_->selected_meshes) {
-        if (e1 == e2) continue;
-
-        auto dist = e1->dist(*e2);
-        if (dist < min_dist) {
-          min_dist = dist;
-          targets = qMakePair(e1, e2);
-        }
-      }
+  // сливаем все выбранные меши в один (первым и последним слоями сливаем): каждый раз - ближайшую пару.
+  // Расстояния между парами считаются один раз и хранятся в очереди с приоритетом; пары с уже
+  // слитыми мешами из нее просто пропускаются.
+  struct Pair {
+    double dist;
+    int first, second;
+
+    bool operator>(const Pair& other) const {
+      return std::tie(dist, first, second) > std::tie(other.dist, other.first, other.second);
     }
+  };
 
-    session_->meshes.removeOne(targets.first);
-    session_->meshes.removeOne(targets.second);
-    session_->selected_meshes.removeOne(targets.first);
-    session_->selected_meshes.removeOne(targets.second);
+  auto handles = session_->scene.selection();
+  QVector<Mesh::HardPtr> meshes;
+  for (auto handle : handles) {
+    meshes.push_back(session_->scene.get(handle));
+  }
+
+  QVector<bool> alive(meshes.size(), true);
+  std::priority_queue<Pair, std::vector<Pair>, std::greater<Pair>> queue;
+  for (int i = 0; i < meshes.size(); ++i) {
+    for (int j = i + 1; j < meshes.size(); ++j) {
+      queue.push(Pair{ meshes[i]->dist(*meshes[j]), i, j });
+    }
+  }
 
-    auto new_mesh = Mesh::unite(targets.first, targets.second);
-    session_->selected_meshes.push_back(new_mesh);
-    session_->addMesh(new_mesh);
+  while (!queue.empty()) {
+    auto pair = queue.top();
+    queue.pop();
+    if (!alive[pair.first] || !alive[pair.second]) continue;
+
+    auto first = meshes[pair.first], second = meshes[pair.second];
+    alive[pair.first] = alive[pair.second] = false;
+
+    session_->scene.remove(handles[pair.first]);
+    session_->scene.remove(handles[pair.second]);
+
+    auto new_mesh = Mesh::unite(first, second);
+    int index = meshes.size();
+    handles.push_back(session_->scene.insert(new_mesh, true));
+    meshes.push_back(new_mesh);
+    alive.push_back(true);
+    for (int i = 0; i < index; ++i) {
+      if (alive[i]) queue.push(Pair{ meshes[i]->dist(*new_mesh), i, index });
+    }
   }
+  afterSceneEdit();
 
   viewport_->updateGL();
 }
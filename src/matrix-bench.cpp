@@ -0,0 +1,111 @@
+﻿#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <new>
+#include <chrono>
+#include <algorithm>
+
+#include <matrix.h>
+#include <algebra.h>
+#include <plane.h>
+
+// Стоимость матричных операций на один слой протяга - то, что делали createLayerPoints, defTexCoord и
+// outLayers: поворот эллипса вокруг оси z и 32 преобразования его точек, кручение вокруг оси слоя и
+// 32 преобразования, одна плоскость по трем точкам. Печатает время и число выделений памяти на слой,
+// а также контрольную сумму: при сборке с разными версиями matrix.h она должна совпадать с точностью до
+// округления (порядок операций с плавающей точкой может отличаться). Сумму другой сборки можно передать
+// вторым аргументом - тогда она сравнивается с относительным допуском.
+
+namespace {
+  unsigned long long allocations = 0;
+}
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+namespace {
+  const int points_per_layer = 32;
+
+  double layer(int index, const vec3d* unit) {
+    double sum = 0.0;
+
+    auto inclination = mat3d::rotZ(0.001 * index);
+    for (int i = 0; i < points_per_layer; ++i) {
+      auto p = unit[i] * inclination;
+      sum += p.x + p.y + p.z;
+    }
+
+    vec3d axis = vec3d(1.0, 0.01 * (index % 100), 0.0).normalize();
+    auto twist = mat3d::rotation(axis, 0.3 + 0.0001 * index);
+    vec3d center(index % 7, index % 11, 0.0);
+    for (int i = 0; i < points_per_layer; ++i) {
+      auto p = (unit[i] * 50.0 - center) * twist;
+      sum += p.x + p.y + p.z;
+    }
+
+    Plane<double> plane(unit[0] * 50.0, unit[points_per_layer / 3] * 50.0 + vec3d(0, index % 5, 0), unit[2 * points_per_layer / 3] * 50.0);
+    return sum + plane.A + plane.B + plane.C + plane.D;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int layers = argc > 1 ? std::atoi(argv[1]) : 200000;
+  if (layers <= 0) {
+    std::fprintf(stderr, "usage: %s [layers [reference checksum]]\n", argv[0]);
+    return 1;
+  }
+
+  vec3d unit[points_per_layer];
+  for (int i = 0; i < points_per_layer; ++i) {
+    double angle = 2.0 * M_PI * i / points_per_layer;
+    unit[i] = vec3d(std::cos(angle), 0.0, std::sin(angle));
+  }
+
+  // лучший из нескольких прогонов - меньше влияние планировщика и прогрева
+  const int runs = 5;
+  double best = 1e300, checksum = 0.0;
+  unsigned long long allocated = 0;
+  for (int run = 0; run < runs; ++run) {
+    double sum = 0.0;
+    unsigned long long before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < layers; ++i) {
+      sum += layer(i, unit);
+    }
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    best = std::min(best, ns / layers);
+    allocated = allocations - before;
+    checksum = sum;
+  }
+
+  std::printf("matrix, per layer (rotZ + %d transforms, rotation + %d transforms, Plane::create):\n", points_per_layer, points_per_layer);
+  std::printf("  %.1f ns, %.1f heap allocations; checksum %.17g\n", best, double(allocated) / layers, checksum);
+
+  if (argc > 2) {
+    const double tolerance = 1e-9; // относительная, с большим запасом над накопленной ошибкой округления
+    double reference = std::atof(argv[2]);
+    double diff = std::fabs(checksum - reference);
+    bool equal = diff <= tolerance * std::max(1.0, std::max(std::fabs(checksum), std::fabs(reference)));
+    std::printf("  reference %.17g: %s (relative difference %.3g)\n", reference, equal ? "equal within rounding" : "DIFFERS",
+      diff / std::max(1.0, std::fabs(reference)));
+    return equal ? 0 : 2;
+  }
+
+  return 0;
+}
@@ -1,66 +1,479 @@
 ﻿#include <mesh.h>
-#include <QtOpenGL>
-#include <fstream>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QHash>
+#include <QBuffer>
+#include <QtMath>
+#include <output-buffer.h>
+#include <point-kernels.h>
+#include <cstring>
+#include <string>
+#include <atomic>
 #include <aabb.h>
 #include <mesh.h>
 #include <defs.h>
-#include <plane.h>
 
 #define TOP_VERT_INDEX			-1
 #define BOTTOM_VERT_INDEX		-2
 
-void Mesh::saveAsObj(const char* file) {
-  std::ofstream out(file);
+namespace {
+  using meshes_t = QVector<const Mesh*>;
+  using compacts_t = std::vector<std::shared_ptr<const rn::CompactMesh>>;
+  using index3_t = std::array<uint32_t, 3>;
 
-  out << "g mesh" << std::endl;
-  out << std::endl;
+  // при экспорте ось y направлена вверх (как и в OBJ); отражение меняет и обход треугольников
+  inline vec3f exported(const vec3f& v) {
+    return vec3f(v.x, -v.y, v.z);
+  }
 
-  out << "# Список вершин" << std::endl;
-  for (auto &e : vertices) {
-    out << "v " << e.x << " " << -e.y << " " << e.z << std::endl;
+  inline index3_t exported(const index3_t& tri) {
+    return index3_t{ { tri[0], tri[2], tri[1] } };
   }
-  out << std::endl;
 
-  out << "# Текстурные координаты" << std::endl;
-  for (auto &e : tex_coord) {
-    out << "vt " << e.x << " " << e.y << " " << std::endl;
+  // нормали вершин в СК экспорта
+  std::vector<vec3f> exportNormals(const rn::CompactMesh& mesh) {
+    std::vector<vec3f> normals;
+    normals.reserve(mesh.normals.size());
+    for (auto code : mesh.normals) {
+      normals.push_back(exported(rn::decodeNormal(code)));
+    }
+    return normals;
   }
-  out << std::endl;
 
-  out << "# Нормали для треугольников" << std::endl;
-  for (auto &e : triangles) {
-    out << "vn " << e.normal.x << " " << e.normal.x << " " << e.normal.z << std::endl;
+  // Все модели пишутся друг за другом одним проходом, индексы смещаются на число уже записанных вершин
+  bool writeObj(const compacts_t& meshes, const char* file) {
+    using rn::format::toChars;
+
+    rn::OutputBuffer out(file, 8 << 20);
+    if (!out.isOpen()) return false;
+
+    const size_t max_line = 128; // с запасом на самую длинную строку ("f" с тремя тройками индексов)
+
+    int offset = 0;
+    for (size_t k = 0; k < meshes.size(); ++k) {
+      auto& mesh = *meshes[k];
+      auto& positions = mesh.positions;
+      auto& tex_coord = mesh.tex_coord;
+      auto& indices = mesh.indices;
+      auto normals = exportNormals(mesh);
+
+      out.write(meshes.size() == 1 ? std::string("g mesh\n\n") : "g mesh_" + std::to_string(k) + "\n\n");
+
+      out.write("# Список вершин\n");
+      rn::writeLines(out, int(positions.size()), max_line, [&positions](char* p, int i) {
+        auto e = exported(positions[i]);
+        *p++ = 'v';
+        *p++ = ' '; p = toChars(p, int(e.x)); // координаты целые
+        *p++ = ' '; p = toChars(p, int(e.y));
+        *p++ = ' '; p = toChars(p, int(e.z));
+        *p++ = '\n';
+        return p;
+      });
+      out.write("\n");
+
+      bool with_uv = !tex_coord.empty();
+      if (with_uv) {
+        out.write("# Текстурные координаты\n");
+        rn::writeLines(out, int(tex_coord.size()), max_line, [&tex_coord](char* p, int i) {
+          auto& e = tex_coord[i];
+          *p++ = 'v'; *p++ = 't';
+          *p++ = ' '; p = toChars(p, double(e.x));
+          *p++ = ' '; p = toChars(p, double(e.y));
+          *p++ = '\n';
+          return p;
+        });
+        out.write("\n");
+      }
+
+      out.write("# Нормали вершин\n");
+      rn::writeLines(out, int(normals.size()), max_line, [&normals](char* p, int i) {
+        auto& e = normals[i];
+        *p++ = 'v'; *p++ = 'n';
+        *p++ = ' '; p = toChars(p, double(e.x));
+        *p++ = ' '; p = toChars(p, double(e.y));
+        *p++ = ' '; p = toChars(p, double(e.z));
+        *p++ = '\n';
+        return p;
+      });
+      out.write("\n");
+
+      out.write("# Треугольники\n");
+      /* f v/vt/vn v/vt/vn v/vt/vn - у вершины один номер во всех трех списках */
+      rn::writeLines(out, int(indices.size()), max_line, [=, &indices](char* p, int i) {
+        auto tri = exported(indices[i]);
+        *p++ = 'f';
+        for (int j = 0; j < 3; ++j) {
+          int index = offset + int(tri[j]) + 1;
+          *p++ = ' ';
+          p = toChars(p, index);
+          *p++ = '/';
+          if (with_uv) p = toChars(p, index);
+          *p++ = '/';
+          p = toChars(p, index);
+        }
+        *p++ = '\n';
+        return p;
+      });
+      out.write("\n");
+
+      offset += int(positions.size());
+    }
+
+    return out.close();
   }
-  out << std::endl;
 
-  out << "# Треугольники" << std::endl;
-  /* f v/vt/vn v/vt/vn v/vt/vn */
-  if (tex_coord.size() > 0) {
-    for (int i = 0; i < triangles.size(); ++i) {
-      auto& tri = triangles[i];
-      out << "f ";
-      out << tri[0] + 1 << "/" << tri[0] + 1 << "/" << i + 1 << " ";
-      out << tri[1] + 1 << "/" << tri[1] + 1 << "/" << i + 1 << " ";
-      out << tri[2] + 1 << "/" << tri[2] + 1 << "/" << i + 1 << " ";
-      out << std::endl;
+  bool writePly(const compacts_t& meshes, const char* file) {
+    rn::OutputBuffer out(file, 8 << 20);
+    if (!out.isOpen()) return false;
+
+    size_t vertex_count = 0, face_count = 0;
+    bool with_uv = !meshes.empty();
+    for (auto& ptr : meshes) {
+      auto& mesh = *ptr;
+      vertex_count += mesh.positions.size();
+      face_count += mesh.indices.size();
+      with_uv = with_uv && !mesh.tex_coord.empty();
+    }
+
+    std::string header =
+      "ply\n"
+      "format binary_little_endian 1.0\n"
+      "element vertex " + std::to_string(vertex_count) + "\n"
+      "property float x\n"
+      "property float y\n"
+      "property float z\n"
+      "property float nx\n"
+      "property float ny\n"
+      "property float nz\n";
+    if (with_uv) {
+      header +=
+        "property float s\n"
+        "property float t\n";
+    }
+    header +=
+      "element face " + std::to_string(face_count) + "\n"
+      "property list uchar int vertex_indices\n"
+      "end_header\n";
+    out.write(header);
+
+    // значения пишутся как есть - рассчитываем на little-endian платформу
+    for (auto& ptr : meshes) {
+      auto& mesh = *ptr;
+      auto normals = exportNormals(mesh);
+      for (size_t i = 0; i < mesh.positions.size(); ++i) {
+        auto v = exported(mesh.positions[i]);
+        auto& n = normals[i];
+
+        out.writeValue(v.x); out.writeValue(v.y); out.writeValue(v.z);
+        out.writeValue(n.x); out.writeValue(n.y); out.writeValue(n.z);
+        if (with_uv) {
+          auto& uv = mesh.tex_coord[i];
+          out.writeValue(uv.x); out.writeValue(uv.y);
+        }
+      }
+    }
+
+    int32_t offset = 0;
+    for (auto& ptr : meshes) {
+      auto& mesh = *ptr;
+      for (auto& e : mesh.indices) {
+        auto tri = exported(e);
+        out.writeValue(uint8_t(3));
+        out.writeValue(int32_t(offset + tri[0])); out.writeValue(int32_t(offset + tri[1])); out.writeValue(int32_t(offset + tri[2]));
+      }
+      offset += int32_t(mesh.positions.size());
     }
+
+    return out.close();
   }
-  else {
-    for (int i = 0; i < triangles.size(); ++i) {
-      auto& tri = triangles[i];
-      out << "f ";
-      out << tri[0] + 1 << "//" << i + 1 << " ";
-      out << tri[1] + 1 << "//" << i + 1 << " ";
-      out << tri[2] + 1 << "//" << i + 1 << " ";
-      out << std::endl;
+
+  bool writeStl(const compacts_t& meshes, const char* file) {
+    rn::OutputBuffer out(file, 8 << 20);
+    if (!out.isOpen()) return false;
+
+    char header[80] = "binary STL, 3d-reconstruction";
+    out.write(header, sizeof(header));
+
+    uint32_t count = 0;
+    for (auto& ptr : meshes) {
+      auto& mesh = *ptr;
+      count += uint32_t(mesh.indices.size());
+    }
+    out.writeValue(count);
+
+    for (auto& ptr : meshes) {
+      auto& mesh = *ptr;
+      for (auto& e : mesh.indices) {
+        auto tri = exported(e);
+        vec3f p[3];
+        for (int i = 0; i < 3; ++i) {
+          p[i] = exported(mesh.positions[tri[i]]);
+        }
+
+        // обход согласован с нормалью наружу - нормаль грани получается векторным произведением
+        vec3d n = (p[1] - p[0]).to<double>().cross((p[2] - p[0]).to<double>());
+        double length = n.length();
+        if (length > 0) n /= length;
+
+        out.writeValue(float(n.x)); out.writeValue(float(n.y)); out.writeValue(float(n.z));
+        for (int i = 0; i < 3; ++i) {
+          out.writeValue(p[i].x); out.writeValue(p[i].y); out.writeValue(p[i].z);
+        }
+        out.writeValue(uint16_t(0)); // attribute byte count
+      }
     }
+
+    return out.close();
   }
 
-  out << std::endl;
-  out.close();
+  // glTF 2.0 (.glb): по одному mesh на каждую уникальную геометрию (geometryId) и по узлу на модель,
+  // перенос и отражение модели - в матрице узла, а не в вершинах
+  bool writeGlb(const meshes_t& meshes, const char* file, const QImage& texture, bool crop_texture) {
+    meshes_t geometries; // первая модель с каждой геометрией
+    compacts_t compacts; // и ее компактное представление
+    QHash<quint64, int> geometry_index;
+    for (auto mesh : meshes) {
+      if (geometry_index.contains(mesh->geometryId())) continue;
+
+      compacts.push_back(mesh->compact());
+      if (compacts.back()->indices.empty()) return false; // в glTF не бывает пустых accessor'ов
+
+      geometry_index.insert(mesh->geometryId(), geometries.size());
+      geometries.push_back(mesh);
+    }
+    if (geometries.isEmpty()) return false;
+
+    bool with_texture = !texture.isNull();
+    for (auto& ptr : compacts) {
+      auto& mesh = *ptr;
+      with_texture = with_texture && !mesh.tex_coord.empty();
+    }
+
+    // в glTF начало текстурных координат - в левом верхнем углу изображения, у нас - в левом нижнем
+    auto to_pixels = [&](const vec2f& uv) {
+      return vec2d(uv.x * texture.width(), (1.0 - uv.y) * texture.height());
+    };
+
+    // часть изображения, на которую ссылаются текстурные координаты
+    QRect area = texture.rect();
+    if (with_texture && crop_texture) {
+      vec2d min(Double::max(), Double::max()), max(Double::lowest(), Double::lowest());
+      for (auto& ptr : compacts) {
+        auto& mesh = *ptr;
+        for (auto& uv : mesh.tex_coord) {
+          auto p = to_pixels(uv);
+          min.x = qMin(min.x, p.x); min.y = qMin(min.y, p.y);
+          max.x = qMax(max.x, p.x); max.y = qMax(max.y, p.y);
+        }
+      }
+
+      QRect used(QPoint(qFloor(min.x) - 1, qFloor(min.y) - 1), QPoint(qCeil(max.x) + 1, qCeil(max.y) + 1));
+      area = used.intersected(texture.rect());
+      if (area.isEmpty()) area = texture.rect();
+    }
+
+    /* Бинарный буфер: позиции, нормали, текстурные координаты, индексы каждой геометрии, изображение */
+    QByteArray bin;
+    QJsonArray views, accessors;
+    auto add_view = [&](const void* data, int length, int target) {
+      while (bin.size() % 4) bin.append('\0'); // данные accessor'ов выравниваются по 4 байта
+
+      QJsonObject view{ { "buffer", 0 }, { "byteOffset", bin.size() }, { "byteLength", length } };
+      if (target) view["target"] = target;
+
+      bin.append(static_cast<const char*>(data), length);
+      views.append(view);
+      return views.size() - 1;
+    };
+    auto add_accessor = [&](int view, int component_type, int count, const char* type) {
+      accessors.append(QJsonObject{ { "bufferView", view }, { "componentType", component_type }, { "count", count }, { "type", type } });
+      return accessors.size() - 1;
+    };
+
+    const int ARRAY_BUFFER = 34962, ELEMENT_ARRAY_BUFFER = 34963, FLOAT = 5126, UNSIGNED_INT = 5125;
+
+    QJsonArray gltf_meshes;
+    for (auto& ptr : compacts) {
+      auto& mesh = *ptr;
+      int count = int(mesh.positions.size());
+      auto normals = exportNormals(mesh);
+
+      std::vector<vec3f> positions;
+      std::vector<vec2f> uv;
+      positions.reserve(count);
+      vec3f min(Type<float>::max(), Type<float>::max(), Type<float>::max());
+      vec3f max(Type<float>::lowest(), Type<float>::lowest(), Type<float>::lowest());
+      for (int i = 0; i < count; ++i) {
+        auto v = exported(mesh.positions[i]);
+        positions.push_back(v);
+        for (int j = 0; j < 3; ++j) {
+          min.coords[j] = qMin(min.coords[j], v.coords[j]);
+          max.coords[j] = qMax(max.coords[j], v.coords[j]);
+        }
+
+        if (with_texture) {
+          auto p = to_pixels(mesh.tex_coord[i]);
+          uv.push_back(vec2f(float((p.x - area.x()) / area.width()), float((p.y - area.y()) / area.height())));
+        }
+      }
+
+      std::vector<index3_t> indices;
+      indices.reserve(mesh.indices.size());
+      for (auto& tri : mesh.indices) {
+        indices.push_back(exported(tri));
+      }
+
+      QJsonObject attributes;
+
+      int view = add_view(positions.data(), int(positions.size() * sizeof(vec3f)), ARRAY_BUFFER);
+      int accessor = add_accessor(view, FLOAT, count, "VEC3");
+      QJsonObject position_accessor = accessors[accessor].toObject(); // для POSITION обязательны границы
+      position_accessor["min"] = QJsonArray{ min.x, min.y, min.z };
+      position_accessor["max"] = QJsonArray{ max.x, max.y, max.z };
+      accessors[accessor] = position_accessor;
+      attributes["POSITION"] = accessor;
+
+      view = add_view(normals.data(), int(normals.size() * sizeof(vec3f)), ARRAY_BUFFER);
+      attributes["NORMAL"] = add_accessor(view, FLOAT, count, "VEC3");
+
+      if (with_texture) {
+        view = add_view(uv.data(), int(uv.size() * sizeof(vec2f)), ARRAY_BUFFER);
+        attributes["TEXCOORD_0"] = add_accessor(view, FLOAT, count, "VEC2");
+      }
+
+      view = add_view(indices.data(), int(indices.size() * sizeof(index3_t)), ELEMENT_ARRAY_BUFFER);
+      int indices_accessor = add_accessor(view, UNSIGNED_INT, int(indices.size() * 3), "SCALAR");
+
+      QJsonObject primitive{ { "attributes", attributes }, { "indices", indices_accessor }, { "material", 0 }, { "mode", 4 } };
+      gltf_meshes.append(QJsonObject{ { "primitives", QJsonArray{ primitive } } });
+    }
+
+    // узел модели: сцена = (flip * x + offset.x, y + offset.y, z + offset.z), в СК экспорта ось y отражена
+    QJsonArray nodes, scene_nodes;
+    for (auto mesh : meshes) {
+      QJsonObject node{ { "mesh", geometry_index[mesh->geometryId()] } };
+      auto offset = mesh->offset();
+      if (offset != vec3i(0, 0, 0)) node["translation"] = QJsonArray{ offset.x, -offset.y, offset.z };
+      if (mesh->mirrored()) node["scale"] = QJsonArray{ -1.0, 1.0, 1.0 };
+
+      scene_nodes.append(nodes.size());
+      nodes.append(node);
+    }
+
+    QJsonObject pbr{ { "metallicFactor", 0.0 }, { "roughnessFactor", 1.0 } };
+
+    QJsonObject root;
+    if (with_texture) {
+      QByteArray png;
+      QBuffer device(&png);
+      device.open(QIODevice::WriteOnly);
+      if (!texture.copy(area).save(&device, "PNG")) return false;
+
+      int view = add_view(png.constData(), png.size(), 0);
+      root["images"] = QJsonArray{ QJsonObject{ { "bufferView", view }, { "mimeType", "image/png" } } };
+      root["samplers"] = QJsonArray{ QJsonObject{ { "magFilter", 9729 }, { "minFilter", 9729 }, { "wrapS", 33071 }, { "wrapT", 33071 } } }; // LINEAR, CLAMP_TO_EDGE
+      root["textures"] = QJsonArray{ QJsonObject{ { "source", 0 }, { "sampler", 0 } } };
+      pbr["baseColorTexture"] = QJsonObject{ { "index", 0 } };
+    }
+    else { // цвет моделей на сцене
+      pbr["baseColorFactor"] = QJsonArray{ 70 / 255.0, 130 / 255.0, 180 / 255.0, 1.0 };
+    }
+
+    while (bin.size() % 4) bin.append('\0');
+
+    root["asset"] = QJsonObject{ { "version", "2.0" }, { "generator", "3d-reconstruction" } };
+    root["scene"] = 0;
+    root["scenes"] = QJsonArray{ QJsonObject{ { "nodes", scene_nodes } } };
+    root["nodes"] = nodes;
+    root["meshes"] = gltf_meshes;
+    root["materials"] = QJsonArray{ QJsonObject{ { "pbrMetallicRoughness", pbr }, { "doubleSided", true } } };
+    root["buffers"] = QJsonArray{ QJsonObject{ { "byteLength", bin.size() } } };
+    root["bufferViews"] = views;
+    root["accessors"] = accessors;
+
+    QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    while (json.size() % 4) json.append(' ');
+
+    /* Контейнер GLB: заголовок, чанк JSON, чанк BIN */
+    rn::OutputBuffer out(file, 8 << 20);
+    if (!out.isOpen()) return false;
+
+    out.writeValue(uint32_t(0x46546C67)); // "glTF"
+    out.writeValue(uint32_t(2));
+    out.writeValue(uint32_t(12 + 8 + json.size() + 8 + bin.size()));
+
+    out.writeValue(uint32_t(json.size()));
+    out.writeValue(uint32_t(0x4E4F534A)); // "JSON"
+    out.write(json.constData(), json.size());
+
+    out.writeValue(uint32_t(bin.size()));
+    out.writeValue(uint32_t(0x004E4942)); // "BIN"
+    out.write(bin.constData(), bin.size());
+
+    return out.close();
+  }
+
+  bool extensionIs(const char* file, const char* expected) {
+    const char* ext = std::strrchr(file, '.');
+    return ext && qstricmp(ext, expected) == 0;
+  }
+}
+
+bool Mesh::saveAsObj(const char* file) const {
+  if (hasTransform()) return baked(clone())->saveAsObj(file);
+  return writeObj(compacts_t{ compact() }, file);
+}
+
+bool Mesh::saveAsPly(const char* file) const {
+  if (hasTransform()) return baked(clone())->saveAsPly(file);
+  return writePly(compacts_t{ compact() }, file);
+}
+
+bool Mesh::saveAsStl(const char* file) const {
+  if (hasTransform()) return baked(clone())->saveAsStl(file);
+  return writeStl(compacts_t{ compact() }, file);
+}
+
+bool Mesh::saveAsGlb(const char* file, const QImage& texture, bool crop_texture) const {
+  return writeGlb(meshes_t{ this }, file, texture, crop_texture);
+}
+
+bool Mesh::save(const char* file, const QImage& texture) const {
+  if (extensionIs(file, ".ply")) return saveAsPly(file);
+  if (extensionIs(file, ".stl")) return saveAsStl(file);
+  if (extensionIs(file, ".glb")) return saveAsGlb(file, texture);
+  return saveAsObj(file);
+}
+
+bool Mesh::saveScene(const QList<Mesh::HardPtr>& meshes, const char* file, const QImage& texture) {
+  if (meshes.isEmpty()) return false;
+
+  if (extensionIs(file, ".glb")) { // glTF хранит общую геометрию один раз, преобразования - в узлах
+    meshes_t list;
+    list.reserve(meshes.size());
+    for (auto& mesh : meshes) {
+      list.push_back(mesh.get());
+    }
+    return writeGlb(list, file, texture, true);
+  }
+
+  // в остальных форматах узлов нет - перенесенные или отраженные модели пишутся по копиям с примененным преобразованием
+  compacts_t compacts;
+  compacts.reserve(meshes.size());
+  for (auto& mesh : meshes) {
+    compacts.push_back(baked(mesh)->compact());
+  }
+
+  if (extensionIs(file, ".ply")) return writePly(compacts, file);
+  if (extensionIs(file, ".stl")) return writeStl(compacts, file);
+  return writeObj(compacts, file);
 }
 
 void Mesh::clear() {
+  invalidate();
+  offset_ = vec3i(0, 0, 0);
+  flip_x_ = 1;
   layers_.clear();
   vertices.clear();
   triangles.clear();
@@ -72,25 +485,16 @@ Mesh& Mesh::mirror(int anchor) {
     anchor = center().x;
   }
 
-  bottom_cover.vertex.x = anchor - (bottom_cover.vertex.x - anchor);
-  top_cover.vertex.x = anchor - (top_cover.vertex.x - anchor);
-
-  for (auto& e : vertices) {
-    e.x = anchor - (e.x - anchor);
-  }
-
-  for (auto &layer : anchor_points) {
-    for (auto &e : layer) {
-      e.x = anchor - (e.x - anchor);
-    }
-  }
+  // x -> anchor - (x - anchor); нормали отражаются вместе с моделью (при отрисовке - матрицей, в bake - явно)
+  flip_x_ = -flip_x_;
+  offset_.x = 2 * anchor - offset_.x;
+  grid_.mirror(anchor);
+  triangle_tree_.mirror(anchor);
 
-  updateNormals();
   return *this;
 }
 
 Mesh& Mesh::swap(Mesh* mesh) {
-  std::swap(texture_id, mesh->texture_id);
   anchor_points.swap(mesh->anchor_points);
   triangles.swap(mesh->triangles);
   vertices.swap(mesh->vertices);
@@ -100,94 +504,266 @@ Mesh& Mesh::swap(Mesh* mesh) {
   std::swap(top_cover.vertex, mesh->top_cover.vertex);
   bottom_cover.triangles.swap(mesh->bottom_cover.triangles);
   std::swap(bottom_cover.vertex, mesh->bottom_cover.vertex);
+  std::swap(grid_, mesh->grid_);
+  std::swap(grid_geometry_, mesh->grid_geometry_);
+  layers_info_.swap(mesh->layers_info_);
+  std::swap(layers_info_geometry_, mesh->layers_info_geometry_);
+  std::swap(offset_, mesh->offset_);
+  std::swap(geometry_, mesh->geometry_);
+  std::swap(flip_x_, mesh->flip_x_);
+  std::swap(triangle_tree_, mesh->triangle_tree_);
+  std::swap(triangle_tree_geometry_, mesh->triangle_tree_geometry_);
+  compact_.swap(mesh->compact_);
 
   return *this;
 }
 
 Mesh& Mesh::move(const vec3i& diff) {
-  bottom_cover.vertex += diff;
-  top_cover.vertex += diff;
+  offset_ += diff;
+  grid_.move(diff.projXY());
+  triangle_tree_.move(diff.to<double>());
+
+  return *this;
+}
+
+bool Mesh::hasTransform() const {
+  return flip_x_ != 1 || offset_ != vec3i(0, 0, 0);
+}
+
+vec3i Mesh::offset() const {
+  return offset_;
+}
+
+bool Mesh::mirrored() const {
+  return flip_x_ < 0;
+}
+
+vec3i Mesh::transformed(const vec3i& v) const {
+  return vec3i(flip_x_ * v.x + offset_.x, v.y + offset_.y, v.z + offset_.z);
+}
+
+template<class Index>
+void Mesh::transformIndex(Index& index) const {
+  if (flip_x_ < 0) index.mirror(0);
+  index.move(offset_.projXY());
+}
+
+template<>
+void Mesh::transformIndex(rn::TriangleTree& index) const {
+  if (flip_x_ < 0) index.mirror(0);
+  index.move(offset_.to<double>());
+}
+
+void Mesh::bake() {
+  if (!hasTransform()) return;
+
   for (auto& e : vertices) {
-    e += diff;
+    e = transformed(e);
   }
+  top_cover.vertex = transformed(top_cover.vertex);
+  bottom_cover.vertex = transformed(bottom_cover.vertex);
 
-  vec2i proj = diff.projXY();
-  for (auto &layer : anchor_points) {
-    for (auto &e : layer) {
-      e += proj;
+  for (auto& layer : anchor_points) {
+    for (auto& e : layer) {
+      e = transformed(vec3i(e, ProjectionPlane::OXY)).projXY();
     }
   }
 
-  return *this;
+  // отражение сохраняет направление нормалей наружу - достаточно отразить их
+  if (flip_x_ < 0) {
+    for (auto triangles : { &this->triangles, &top_cover.triangles, &bottom_cover.triangles }) {
+      for (auto& tri : *triangles) {
+        tri.normal.x = -tri.normal.x;
+      }
+    }
+  }
+
+  // индексы уже в СК сцены и остаются верными, пересчитываются только центры и нормали слоев
+  layers_info_geometry_ = 0;
+  touch();
+  offset_ = vec3i(0, 0, 0);
+  flip_x_ = 1;
+}
+
+Mesh::HardPtr Mesh::baked(const Mesh::HardPtr& mesh) {
+  if (!mesh->hasTransform()) return mesh;
+
+  auto copy = mesh->clone();
+  copy->bake();
+  return copy;
 }
 
 vec3i Mesh::center() const {
-  return createAABB<int>(vertices.begin(), vertices.end()).center();
+  // центр считаем по габаритам в СК сцены: при отражении округление центра зависит от направления оси
+  auto box = createAABB<int>(vertices.begin(), vertices.end());
+  auto p = transformed(box.min), q = transformed(box.max);
+  box.min = vec3i(std::min(p.x, q.x), p.y, p.z);
+  box.max = vec3i(std::max(p.x, q.x), q.y, q.z);
+  return box.center();
+}
+
+void Mesh::invalidate() {
+  geometry_ = newGeometryId(); // пометки вычисленных данных остаются на прежнем id
+}
+
+void Mesh::touch() {
+  quint64 previous = geometry_;
+  geometry_ = newGeometryId();
+
+  if (grid_geometry_ == previous) grid_geometry_ = geometry_;
+  if (layers_info_geometry_ == previous) layers_info_geometry_ = geometry_;
+  if (triangle_tree_geometry_ == previous) triangle_tree_geometry_ = geometry_;
+}
+
+quint64 Mesh::newGeometryId() {
+  static std::atomic<quint64> next(1); // модели создаются и в рабочих потоках
+  return next++;
+}
+
+quint64 Mesh::geometryId() const {
+  return geometry_;
+}
+
+const QVector<Mesh::LayerInfo>& Mesh::layersInfo() const {
+  if (layers_info_geometry_ == geometry_) {
+    return layers_info_;
+  }
+
+  layers_info_.clear();
+  layers_info_.reserve(layers_.size());
+  for (auto& layer : layers_) {
+    LayerInfo info;
+    info.center = layerCenter(layer);
+    info.normal = vec3d(0, 0, 0);
+    info.collapsed = layer.second - layer.first < 3;
+
+    if (!info.collapsed) {
+      auto f = vec3i(vert(layer.first)).to<double>();
+      auto s = vec3i(vert(layer.first + 1)).to<double>();
+      auto& c = info.center;
+
+      // точки практически слиты в одну
+      info.collapsed = f.dist(c) < 2.5 && f.dist(s) < 2.5 && s.dist(c) < 2.5;
+      info.normal = (s - f).cross(c - f); // совпадает с нормалью Plane(f, s, c)
+    }
+
+    layers_info_.push_back(info);
+  }
+  layers_info_geometry_ = geometry_;
+
+  return layers_info_;
+}
+
+const rn::PointGrid& Mesh::grid() const {
+  // vertices - открытое поле, поэтому дополнительно сверяем число точек
+  if (grid_geometry_ != geometry_ || grid_.size() != vertices.size()) {
+    grid_ = rn::PointGrid(vertices);
+    transformIndex(grid_);
+    grid_geometry_ = geometry_;
+  }
+
+  return grid_;
+}
+
+const rn::TriangleTree& Mesh::triangleTree() const {
+  int count = triangles.size() + top_cover.triangles.size() + bottom_cover.triangles.size();
+  if (triangle_tree_geometry_ != geometry_ || triangle_tree_.size() != count) {
+    triangle_tree_ = rn::TriangleTree(*this);
+    transformIndex(triangle_tree_);
+    triangle_tree_geometry_ = geometry_;
+  }
+
+  return triangle_tree_;
 }
 
 double Mesh::dist(const Mesh& other, bool by_covers) const {
-  QVector<vec3i> verts[2];
   if (!by_covers) {
-    verts[0] = vertices;
-    verts[1] = other.vertices;
+    return grid().dist(other.grid());
   }
-  else {
-    // первый и последний слои
-    auto last_layer = layers_.last();
-    auto first_layer = layers_.first();
-    verts[0].reserve((last_layer.second - last_layer.first) + (first_layer.second - first_layer.first));
-    for (int i = first_layer.first; i < first_layer.second; ++i) verts[0] << vertices[i];
-    for (int i = last_layer.first; i < last_layer.second; ++i) verts[0] << vertices[i];
 
-    // первый и последний слои other
-    auto last_layer2 = other.layers_.last();
-    auto first_layer2 = other.layers_.first();
-    verts[1].reserve((last_layer2.second - last_layer2.first) + (first_layer2.second - first_layer2.first));
-    for (int i = first_layer2.first; i < first_layer2.second; ++i) verts[1] << other.vertices[i];
-    for (int i = last_layer2.first; i < last_layer2.second; ++i) verts[1] << other.vertices[i];
+  // первый и последний слои обеих моделей - точек немного, сравниваем все со всеми
+  layer_t ranges[2][2] = {
+    { layers_.first(), layers_.last() },
+    { other.layers_.first(), other.layers_.last() }
+  };
+
+  rn::Points3d others;
+  for (auto& r2 : ranges[1]) {
+    for (int j = r2.first; j < r2.second; ++j) {
+      auto p = other.transformed(other.vertices[j]);
+      others.x.push_back(p.x);
+      others.y.push_back(p.y);
+    }
   }
+  others.z.resize(others.x.size());
 
   double dist = Double::max();
-  for (auto& e1 : verts[0]) {
-    for (auto& e2 : verts[1]) {
-      dist = std::min(dist, e1.projXY().dist(e2.projXY()));
+  for (auto& r1 : ranges[0]) {
+    for (int i = r1.first; i < r1.second; ++i) {
+      auto p = transformed(vertices[i]);
+      dist = std::min(dist, rn::kernels::minDistXY(vec2d(p.x, p.y), others));
     }
   }
 
   return dist;
 }
 
-bool Mesh::fallsInto(const QRect& rect) const {
-  for (auto& v : vertices) {
-    if (rect.contains(QPoint(v.x, v.y))) return true;
+rn::BoxTree::Box Mesh::bounds() const {
+  rn::BoxTree::Box box;
+  if (!grid().isEmpty()) {
+    box = rn::BoxTree::Box(grid().min(), grid().max());
   }
 
-  return false;
+  for (auto& layer : anchor_points) { // опорные точки хранятся в локальных координатах
+    for (auto& e : { layer[0], layer[1] }) {
+      auto p = transformed(vec3i(e, ProjectionPlane::OXY)).projXY();
+      box = box.united(rn::BoxTree::Box(p, p));
+    }
+  }
+
+  return box;
 }
 
-bool Mesh::contains(const QPoint& point) const {
-  int n = anchor_points.size();
-  for (int i = 0; i < n - 1; ++i) {
-    QPolygon polygon;
-    polygon << QPoint(anchor_points[i][0].x, anchor_points[i][0].y);
-    polygon << QPoint(anchor_points[i][1].x, anchor_points[i][1].y);
-    polygon << QPoint(anchor_points[i + 1][1].x, anchor_points[i + 1][1].y);
-    polygon << QPoint(anchor_points[i + 1][0].x, anchor_points[i + 1][0].y);
+bool Mesh::fallsInto(const QRect& rect) const {
+  QRect area = rect.normalized(); // QRect::contains тоже не учитывает направление сторон
+  return grid().anyIn(vec2i(area.left(), area.top()), vec2i(area.right(), area.bottom()));
+}
 
-    if (polygon.containsPoint(point, Qt::FillRule::OddEvenFill)) {
-      return true;
-    }
-  }
+double Mesh::intersect(const rn::Ray& ray, double limit, int* triangle) const {
+  return triangleTree().intersect(ray, limit, triangle);
+}
 
-  return false;
+size_t Mesh::memoryUsage() const {
+  size_t bytes = sizeof(*this);
+  bytes += vertices.capacity() * sizeof(vec3i);
+  bytes += triangles.capacity() * sizeof(Trid);
+  bytes += tex_coord.capacity() * sizeof(vec2d);
+  bytes += layers_.capacity() * sizeof(layer_t);
+  bytes += layers_info_.capacity() * sizeof(LayerInfo);
+  bytes += (top_cover.triangles.capacity() + bottom_cover.triangles.capacity()) * sizeof(Trid);
+  bytes += anchor_points.capacity() * sizeof(rn::AnchorLayer);
+
+  bytes += grid_.memoryUsage() + triangle_tree_.memoryUsage();
+  auto cache = std::atomic_load(&compact_);
+  if (cache && cache->geometry == geometry_) bytes += cache->mesh.memoryUsage();
+  return bytes;
 }
 
 Mesh::HardPtr Mesh::clone() const {
   Mesh::HardPtr mesh(new Mesh());
   mesh->layers_ = layers_;
+  mesh->grid_ = grid_;
+  mesh->grid_geometry_ = grid_geometry_;
+  mesh->layers_info_ = layers_info_;
+  mesh->layers_info_geometry_ = layers_info_geometry_;
+  mesh->triangle_tree_ = triangle_tree_;
+  mesh->triangle_tree_geometry_ = triangle_tree_geometry_;
+  mesh->compact_ = std::atomic_load(&compact_);
+  mesh->offset_ = offset_;
+  mesh->flip_x_ = flip_x_;
+  mesh->geometry_ = geometry_;
   mesh->vertices = vertices;
   mesh->triangles = triangles;
-  mesh->texture_id = texture_id;
   mesh->tex_coord = tex_coord;
   mesh->anchor_points = anchor_points;
   mesh->bottom_cover = bottom_cover;
@@ -196,7 +772,186 @@ Mesh::HardPtr Mesh::clone() const {
   return mesh;
 }
 
-Mesh::HardPtr Mesh::unite(const Mesh::HardPtr& first, const Mesh::HardPtr& second) {
+std::shared_ptr<const rn::CompactMesh> Mesh::compact() const {
+  auto cache = std::atomic_load(&compact_);
+  if (!cache || cache->geometry != geometry_) {
+    auto built = std::make_shared<CompactCache>();
+    built->geometry = geometry_;
+    built->mesh = makeCompact();
+    cache = built;
+    std::atomic_store(&compact_, cache);
+  }
+  return std::shared_ptr<const rn::CompactMesh>(cache, &cache->mesh);
+}
+
+rn::CompactMesh Mesh::makeCompact() const {
+  rn::CompactMesh dst;
+
+  // у веера крышки вершин обода не больше, чем треугольников, плюс центр
+  bool with_uv = !tex_coord.isEmpty() && tex_coord.size() == vertices.size();
+  int count = vertices.size() + top_cover.triangles.size() + bottom_cover.triangles.size() + 2;
+  dst.positions.reserve(count);
+  for (auto& e : vertices) {
+    dst.positions.push_back(e.to<float>());
+  }
+  if (with_uv) {
+    dst.tex_coord.reserve(count);
+    for (auto& e : tex_coord) {
+      dst.tex_coord.push_back(e);
+    }
+  }
+
+  // вершины крышки - копии вершин обода (в порядке обхода ее треугольников) и центр
+  auto add_cover = [&](const Cover& cover, int center, QHash<int, uint32_t>& indices) {
+    for (auto& e : cover.triangles) {
+      for (int i = 0; i < 3; ++i) {
+        if (e[i] == center || indices.contains(e[i])) continue;
+
+        indices.insert(e[i], uint32_t(dst.positions.size()));
+        dst.positions.push_back(vertices[e[i]].to<float>());
+        dst.rims.push_back(uint32_t(e[i]));
+        if (with_uv) dst.tex_coord.push_back(tex_coord[e[i]]);
+      }
+    }
+
+    indices.insert(center, uint32_t(dst.positions.size()));
+    dst.positions.push_back((*this)[center].to<float>());
+    if (with_uv) dst.tex_coord.push_back(tex(center));
+  };
+
+  QHash<int, uint32_t> top, bottom;
+  dst.rims.reserve(top_cover.triangles.size() + bottom_cover.triangles.size());
+  if (!top_cover.triangles.isEmpty()) add_cover(top_cover, TOP_VERT_INDEX, top);
+  dst.top_rim = static_cast<int>(dst.rims.size());
+  if (!bottom_cover.triangles.isEmpty()) add_cover(bottom_cover, BOTTOM_VERT_INDEX, bottom);
+
+  // обход треугольника согласуем с его нормалью, нормали вершин - среднее нормалей треугольников
+  struct {
+    const QVector<Trid>* triangles;
+    const QHash<int, uint32_t>* indices; // номера вершин крышки, nullptr - у боковой поверхности свои
+  } lists[] = { { &triangles, nullptr }, { &top_cover.triangles, &top }, { &bottom_cover.triangles, &bottom } };
+
+  std::vector<vec3d> normals(dst.positions.size(), vec3d(0, 0, 0));
+  dst.indices.reserve(triangles.size() + top_cover.triangles.size() + bottom_cover.triangles.size());
+  for (auto& list : lists) {
+    for (auto& e : *list.triangles) {
+      std::array<uint32_t, 3> tri;
+      for (int i = 0; i < 3; ++i) {
+        tri[i] = list.indices ? list.indices->value(e[i]) : uint32_t(e[i]);
+        normals[tri[i]] += e.normal;
+      }
+
+      auto& a = dst.positions[tri[0]];
+      vec3d face = (dst.positions[tri[1]] - a).to<double>().cross((dst.positions[tri[2]] - a).to<double>());
+      if (face.dot(e.normal) < 0) std::swap(tri[1], tri[2]);
+      dst.indices.push_back(tri);
+    }
+  }
+  dst.top_triangles = top_cover.triangles.size();
+  dst.bottom_triangles = bottom_cover.triangles.size();
+
+  dst.normals.reserve(normals.size());
+  for (auto& n : normals) {
+    dst.normals.push_back(rn::encodeNormal(n));
+  }
+
+  dst.anchors.reserve(anchor_points.size() * rn::CompactMesh::anchors_per_layer);
+  for (auto& layer : anchor_points) {
+    dst.anchors.insert(dst.anchors.end(), layer.begin(), layer.end());
+  }
+
+  dst.layers.reserve(layers_.size() * 2);
+  for (auto& layer : layers_) {
+    dst.layers.push_back(layer.first);
+    dst.layers.push_back(layer.second);
+  }
+
+  return dst;
+}
+
+Mesh::HardPtr Mesh::fromCompact(const rn::CompactMesh& src) {
+  Mesh::HardPtr mesh(new Mesh());
+
+  int covers = (src.top_triangles ? 1 : 0) + (src.bottom_triangles ? 1 : 0);
+  int count = static_cast<int>(src.positions.size() - src.rims.size()) - covers;
+
+  // вершины крышек (копии обода и центры) - обратно в номера вершин слоев и фиктивные индексы центров
+  std::vector<int> sources;
+  sources.reserve(src.positions.size());
+  for (int i = 0; i < count; ++i) {
+    sources.push_back(i);
+  }
+  if (src.top_triangles) {
+    sources.insert(sources.end(), src.rims.begin(), src.rims.begin() + src.top_rim);
+    sources.push_back(TOP_VERT_INDEX);
+  }
+  if (src.bottom_triangles) {
+    sources.insert(sources.end(), src.rims.begin() + src.top_rim, src.rims.end());
+    sources.push_back(BOTTOM_VERT_INDEX);
+  }
+
+  auto to_vertex = [](const vec3f& e) {
+    return vec3i(qRound(e.x), qRound(e.y), qRound(e.z));
+  };
+
+  mesh->vertices.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    mesh->vertices.push_back(to_vertex(src.positions[i]));
+  }
+  for (size_t i = count; i < sources.size(); ++i) {
+    if (sources[i] == TOP_VERT_INDEX) mesh->top_cover.vertex = to_vertex(src.positions[i]);
+    else if (sources[i] == BOTTOM_VERT_INDEX) mesh->bottom_cover.vertex = to_vertex(src.positions[i]);
+  }
+
+  auto to_triangle = [&sources](const std::array<uint32_t, 3>& e) {
+    Trid tri;
+    for (int i = 0; i < 3; ++i) {
+      tri[i] = sources[e[i]];
+    }
+    return tri;
+  };
+
+  // обход согласован с нормалью наружу - нормали восстанавливаются векторным произведением ребер
+  int faces = static_cast<int>(src.indices.size());
+  rn::Points3d p(faces), q(faces), normals;
+  for (int i = 0; i < faces; ++i) {
+    auto& a = src.positions[src.indices[i][0]];
+    p.set(i, (src.positions[src.indices[i][1]] - a).to<double>());
+    q.set(i, (src.positions[src.indices[i][2]] - a).to<double>());
+  }
+  rn::kernels::cross(p, q, normals);
+  rn::kernels::normalize(normals);
+
+  int side = src.sideTriangles();
+  for (int i = 0; i < faces; ++i) {
+    auto tri = to_triangle(src.indices[i]);
+    tri.normal = normals.at(i);
+    if (i < side) mesh->triangles.push_back(tri);
+    else if (i < side + src.top_triangles) mesh->top_cover.triangles.push_back(tri);
+    else mesh->bottom_cover.triangles.push_back(tri);
+  }
+
+  // текстурные координаты крышек берутся у вершин их треугольников (см. tex)
+  for (int i = 0; i < count && i < static_cast<int>(src.tex_coord.size()); ++i) {
+    mesh->tex_coord.push_back(src.tex_coord[i]);
+  }
+
+  for (size_t i = 0; i + rn::CompactMesh::anchors_per_layer <= src.anchors.size(); i += rn::CompactMesh::anchors_per_layer) {
+    rn::AnchorLayer layer;
+    std::copy(src.anchors.begin() + i, src.anchors.begin() + i + layer.size(), layer.begin());
+    mesh->anchor_points.push_back(layer);
+  }
+
+  for (size_t i = 0; i + 1 < src.layers.size(); i += 2) {
+    mesh->layers_.push_back(layer_t(src.layers[i], src.layers[i + 1]));
+  }
+
+  return mesh;
+}
+
+Mesh::HardPtr Mesh::unite(const Mesh::HardPtr& first_mesh, const Mesh::HardPtr& second_mesh) {
+  // вершины обеих моделей нужны в координатах сцены
+  auto first = baked(first_mesh), second = baked(second_mesh);
   auto near_layers = findNearestLayers(*first, *second);
 
   int vertices_count = static_cast<int>(first->vertices.size());
@@ -215,9 +970,6 @@ Mesh::HardPtr Mesh::unite(const Mesh::HardPtr& first, const Mesh::HardPtr& secon
 
   Mesh::HardPtr dst(new Mesh());
 
-  // выбираем ненулевую текстуру, если она есть
-  dst->texture_id = first->texture_id ? first->texture_id : second->texture_id;
-
   dst->vertices << first->vertices;
   dst->vertices << second->vertices;
 
@@ -239,7 +991,8 @@ Mesh::HardPtr Mesh::unite(const Mesh::HardPtr& first, const Mesh::HardPtr& secon
   return dst;
 }
 
-Mesh::HardPtr Mesh::merge(const Mesh::HardPtr& first, const Mesh::HardPtr& second) {
+Mesh::HardPtr Mesh::merge(const Mesh::HardPtr& first_mesh, const Mesh::HardPtr& second_mesh) {
+  auto first = baked(first_mesh), second = baked(second_mesh); // сливаются координаты сцены
   int vertices_count = static_cast<int>(first->vertices.size());
   auto triangles_copy = second->triangles;
   for (auto &e : triangles_copy) {
@@ -256,9 +1009,6 @@ Mesh::HardPtr Mesh::merge(const Mesh::HardPtr& first, const Mesh::HardPtr& secon
 
   Mesh::HardPtr dst(new Mesh());
 
-  // выбираем ненулевую текстуру, если она есть
-  dst->texture_id = first->texture_id ? first->texture_id : second->texture_id;
-
   dst->vertices << first->vertices;
   dst->vertices << second->vertices;
 
@@ -279,19 +1029,18 @@ Mesh::HardPtr Mesh::merge(const Mesh::HardPtr& first, const Mesh::HardPtr& secon
 }
 
 QPair<int, int> Mesh::findNearestLayers(const Mesh& first, const Mesh& second) {
+  auto first_out = first.outLayers(), second_out = second.outLayers();
   QVector<int> first_covers, second_covers; // индексы слоев
-  first_covers << first.outLayers().first;
-  first_covers << first.outLayers().second;
-  second_covers << second.outLayers().first;
-  second_covers << second.outLayers().second;
+  first_covers << first_out.first << first_out.second;
+  second_covers << second_out.first << second_out.second;
 
   QPair<int, int> dst = { 0, 0 };
   double min_dist = Double::max();
   for (auto i : first_covers) {
     // будем сравнивать расстояния между центрами слоев
-    auto first_center = first.layerCenter(first.layers_[i]);
+    auto first_center = first.layersInfo()[i].center;
     for (auto j : second_covers) {
-      auto second_center = second.layerCenter(second.layers_[j]);
+      auto& second_center = second.layersInfo()[j].center;
       double dist = first_center.dist(second_center);
       if (dist < min_dist) {
         min_dist = dist;
@@ -337,31 +1086,44 @@ const vec3i& Mesh::operator[](int index) const {
 }
 
 void Mesh::updateNormals() {
-  auto update_for = [=](QVector<Trid>& triangles, bool is_cover) {
-    for (auto& tri : triangles) {
-      vec3d p = vert(tri[0]).to<double>() - vert(tri[1]).to<double>();
-      vec3d q = vert(tri[2]).to<double>() - vert(tri[1]).to<double>();
-      vec3d n = p.cross(q);
-
-      vec3d center;
-      if (is_cover) { // смотрим на центр всей модели
-        center = createAABB<int>(vertices.begin(), vertices.end()).center();
-      }
-      else { // смотрим на центр слоя
-        auto layer_it = getLayerPoints(getLayer(tri[0])); // слой одной из точек треугольника
-        center = createAABB<int>(layer_it.first, layer_it.second).center();
-      }
+  // нормаль смотрит наружу: от центра слоя (у крышек - от центра модели); центры считаем один раз
+  auto model_center = createAABB<int>(vertices.begin(), vertices.end()).center();
+  QVector<vec3i> layer_centers;
+  layer_centers.reserve(layers_.size());
+  QVector<int> layer_of(vertices.size(), -1); // первый слой, содержащий вершину (как в getLayer)
+  for (int i = 0; i < layers_.size(); ++i) {
+    auto layer_it = getLayerPoints(i);
+    layer_centers.push_back(createAABB<int>(layer_it.first, layer_it.second).center());
+    for (int j = layers_[i].first; j < layers_[i].second; ++j) {
+      if (layer_of[j] < 0) layer_of[j] = i;
+    }
+  }
 
-      // опред. правильное направление нормали - наружу из центра
-      if (n.angle(vert(tri[0]).to<double>() - center) > math::Pi_2) n *= -1;
+  auto update_for = [&](QVector<Trid>& triangles, bool is_cover) {
+    int count = triangles.size();
+    rn::Points3d p(count), q(count), outward(count), normals;
+    for (int i = 0; i < count; ++i) {
+      auto& tri = triangles[i];
+      auto& a = vert(tri[0]), & b = vert(tri[1]), & c = vert(tri[2]);
+      auto& center = is_cover ? model_center : layer_centers[layer_of[tri[0]]];
+
+      p.x[i] = a.x - b.x; p.y[i] = a.y - b.y; p.z[i] = a.z - b.z;
+      q.x[i] = c.x - b.x; q.y[i] = c.y - b.y; q.z[i] = c.z - b.z;
+      outward.x[i] = a.x - center.x; outward.y[i] = a.y - center.y; outward.z[i] = a.z - center.z;
+    }
 
-      tri.normal = n.normalize();
+    rn::kernels::cross(p, q, normals);
+    rn::kernels::orient(normals, outward);
+    rn::kernels::normalize(normals);
+    for (int i = 0; i < count; ++i) {
+      triangles[i].normal = normals.at(i);
     }
   };
 
   update_for(triangles, false);
   update_for(top_cover.triangles, true);
   update_for(bottom_cover.triangles, true);
+  touch();
 }
 
 vec3d Mesh::layerCenter(const layer_t& layer) const {
@@ -371,43 +1133,26 @@ vec3d Mesh::layerCenter(const layer_t& layer) const {
 }
 
 QPair<int, int> Mesh::outLayers() const {
-  QPair<int, int> out_layers = { 0, 0 };
-  QPair<int, int> out_layers_price = { Int::max(), Int::min() }; // вспомогательная переменная, оценивает можность слоя
-  for (int i = 0; i < layers_.size(); ++i) {
-    auto layer = layers_[i];
-    if (layer.second - layer.first < 3) continue;
-
-    auto f = vec3i(vert(layer.first)).to<double>();
-    auto s = vec3i(vert(layer.first + 1)).to<double>();
-    auto ray_start = layerCenter(layer);
-
-    if (f.dist(ray_start) < 2.5 && f.dist(s) < 2.5 && s.dist(ray_start) < 2.5) {
-      // то это слой, в котором точки практически слиты в одну
-      continue;
-    }
-
-    Plane<double> plane(f, s, ray_start);
-    vec3d ray_normal = plane.normal().normalize();
-
-    int counter[2] = { 0, 0 }; // сколько плоскостей пересекает нормаль и инверированная нормаль текущего слоя
-    for (auto other : layers_) {
-      if (other == layer) continue;
-      if (other.second - other.first < 3) continue;
-
-      auto f = vec3i(vert(other.first)).to<double>();
-      auto s = vec3i(vert(other.first + 1)).to<double>();
-      auto t = layerCenter(other);
-
-      if (f.dist(t) < 2.5 && f.dist(s) < 2.5 && s.dist(t) < 2.5) {
-        continue; // очень `плотный` слой
-      }
+  auto& info = layersInfo();
+
+  // Ось протягивания - сумма нормалей слоев, приведенных к одной ориентации (вклад слоя пропорционален
+  // его площади). Крайние слои - с наименьшей и наибольшей проекцией центра на эту ось; слитые в точку
+  // слои не учитываются.
+  vec3d axis(0, 0, 0);
+  for (auto& e : info) {
+    if (e.collapsed) continue;
+
+    vec3d normal = e.normal;
+    if (axis.dot(normal) < 0) normal *= -1;
+    axis += normal;
+  }
 
-      Plane<double> other_plane(f, s, t);
-      if (other_plane.intersect(ray_start, ray_normal)) counter[0] += 1;
-      if (other_plane.intersect(ray_start, ray_normal * -1.0)) counter[1] += 1;
-    }
+  QPair<int, int> out_layers = { 0, 0 };
+  QPair<double, double> out_layers_price = { Double::max(), Double::lowest() };
+  for (int i = 0; i < info.size(); ++i) {
+    if (info[i].collapsed) continue;
 
-    int price = counter[0] - counter[1];
+    double price = axis.dot(info[i].center);
     if (price < out_layers_price.first) {
       out_layers_price.first = price;
       out_layers.first = i;
@@ -419,7 +1164,7 @@ QPair<int, int> Mesh::outLayers() const {
     }
   }
 
-  if (layerCenter(layers_[out_layers.first]).y > layerCenter(layers_[out_layers.second]).y) {
+  if (!info.isEmpty() && info[out_layers.first].center.y > info[out_layers.second].center.y) {
     std::swap(out_layers.first, out_layers.second);
   }
 
@@ -429,9 +1174,11 @@ QPair<int, int> Mesh::outLayers() const {
 void Mesh::triangulateLastLayer() {
   top_cover.need_triangulate = true;
 
-  auto layer = layers_[outLayers().second];
-  top_cover.vertex = layerCenter(layer); // точка схода вершин последнего слоя
+  int index = outLayers().second;
+  auto layer = layers_[index];
+  top_cover.vertex = layersInfo()[index].center; // точка схода вершин последнего слоя
   top_cover.triangles.clear();
+  triangle_tree_geometry_ = 0;
 
   // третий индекс - фиктивный, вместо него будет bottom_cover.first
   top_cover.triangles.push_back(Trid(layer.second - 1, layer.first, TOP_VERT_INDEX));
@@ -445,9 +1192,11 @@ void Mesh::triangulateLastLayer() {
 void Mesh::triangulateFirstLayer() {
   bottom_cover.need_triangulate = true;
 
-  auto layer = layers_[outLayers().first];
-  bottom_cover.vertex = layerCenter(layer); // точка схода вершин первого слоя
+  int index = outLayers().first;
+  auto layer = layers_[index];
+  bottom_cover.vertex = layersInfo()[index].center; // точка схода вершин первого слоя
   bottom_cover.triangles.clear();
+  triangle_tree_geometry_ = 0;
 
   // третий индекс - фиктивный, вместо него будет top_cover.first
   bottom_cover.triangles.push_back(Trid(layer.second - 1, layer.first, BOTTOM_VERT_INDEX));
@@ -476,6 +1225,7 @@ void Mesh::removeLayer(int index) {
 
   triangles.erase(std::remove_if(triangles.begin(), triangles.end(), removedTri), triangles.end());
   vertices.erase(vertices.begin() + layer.first, vertices.begin() + layer.second);
+  invalidate();
 }
 
 void Mesh::removeLastLayer() {
@@ -484,6 +1234,7 @@ void Mesh::removeLastLayer() {
 
 void Mesh::addTexCoords(const QVector<vec2d>& coords) {
   tex_coord << coords;
+  touch();
 }
 
 void Mesh::addLayer(const QVector<vec3i>& layer) {
@@ -500,24 +1251,39 @@ void Mesh::addLayer(const QVector<vec3i>& layer) {
 }
 
 void Mesh::newLayer(const QVector<vec3i>& vs) {
+  bake(); // новые вершины - в координатах сцены
   QPair<size_t, size_t> layer;
   layer.first = vertices.size();
   layer.second = layer.first + vs.size();
 
   layers_.push_back(layer);
   vertices << vs;
+  invalidate();
 }
 
 void Mesh::triangleLayers(const layer_t& first, const layer_t& second) {
-  int cur = second.first;
-  for (int i = first.first; i < first.second - 1; ++i) {
-    addTriangle(i, cur, i + 1);
-    addTriangle(cur, cur + 1, i + 1);
-    ++cur;
+  int n = first.second - first.first, m = second.second - second.first;
+  if (n <= 0 || m <= 0) {
+    return;
   }
 
-  addTriangle(first.second - 1, cur, first.first);
-  addTriangle(second.second - 1, second.first, first.first);
+  auto a = [&first, n](int i) { return first.first + i % n; };
+  auto b = [&second, m](int j) { return second.first + j % m; };
+
+  // Точки слоев равномерны по окружности и начинаются с одного угла, поэтому слои "застегиваются":
+  // на каждом шаге продвигаемся по тому слою, чья следующая точка раньше по доле оборота (при равенстве -
+  // по первому), всего n + m треугольников. Для слоев одного размера это прежняя пара треугольников на
+  // каждый отрезок.
+  for (int i = 0, j = 0; i < n || j < m; ) {
+    if (j == m || (i < n && (i + 1) * m <= (j + 1) * n)) {
+      addTriangle(a(i), b(j), a(i + 1));
+      ++i;
+    }
+    else {
+      addTriangle(b(j), b(j + 1), a(i));
+      ++j;
+    }
+  }
 }
 
 int Mesh::getLayer(int vert_index) const {
@@ -544,64 +1310,7 @@ QPair<Mesh::vertices_t::iterator, Mesh::vertices_t::iterator> Mesh::getLayerPoin
 
 size_t Mesh::addTriangle(size_t ind1, size_t ind2, size_t ind3) {
   triangles.push_back(Trid(ind1, ind2, ind3));
+  triangle_tree_geometry_ = 0;
+  touch();
   return triangles.size() - 1;
 }
-
-void Mesh::render(const vec3b& color, bool texturing, bool selected) const {
-  bool use_texture = texturing && !tex_coord.empty();
-
-  glEnable(GL_NORMALIZE);
-  glEnable(GL_LIGHTING);
-
-  if (use_texture) {
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-  }
-
-  auto& mesh = *this;
-
-  auto triangles = mesh.triangles;
-  triangles << top_cover.triangles;
-  triangles << bottom_cover.triangles;
-  glBegin(GL_TRIANGLES);
-  for (auto& tri : triangles) {
-    if (selected) glColor3ub(255, 0, 0);
-    else if (use_texture) glColor3ub(255, 255, 255);
-    else glColor3ubv(color.coords);
-
-    glNormal3dv(tri.normal.coords);
-    if (use_texture) glTexCoord2dv(tex(tri[0]).coords);
-    glVertex3iv(mesh[tri[0]].coords);
-
-    glNormal3dv(tri.normal.coords);
-    if (use_texture) glTexCoord2dv(tex(tri[1]).coords);
-    glVertex3iv(mesh[tri[1]].coords);
-
-    glNormal3dv(tri.normal.coords);
-    if (use_texture) glTexCoord2dv(tex(tri[2]).coords);
-    glVertex3iv(mesh[tri[2]].coords);
-  }
-  glEnd();
-
-  if (use_texture) {
-    glDisable(GL_TEXTURE_2D);
-  }
-
-  glDisable(GL_LIGHTING);
-  glDisable(GL_NORMALIZE);
-
-#ifndef NDEBUG
-  if (selected && use_texture) {
-    glLineWidth(5);
-    glColor3d(1, 0, 0);
-    glBegin(GL_LINE_STRIP);
-    for(auto &e: anchor_points) glVertex2iv(e[0].coords);
-    glEnd();
-    glBegin(GL_LINE_STRIP);
-    for (auto &e: anchor_points) glVertex2iv(e[1].coords);
-    glEnd();
-    glLineWidth(1);
-  }
-#endif
-  glColor3d(1, 1, 1);
-}
@@ -49,10 +49,14 @@ namespace rn {
     Q_ASSERT(false);
   }
 
-  Mesh::HardPtr ModelCreator::createMeshFromLayers(const QVector<QVector<vec2i>>& layers) {
+  Mesh::HardPtr ModelCreator::createMeshFromLayers(const AnchorLayers& layers) {
     Q_UNUSED(layers);
 
     Q_ASSERT(false);
     return nullptr;
   }
+
+  ModelCreator::Preview ModelCreator::preview() const {
+    return Preview();
+  }
 }
@@ -0,0 +1,134 @@
+﻿#include <output-buffer.h>
+#include <cstring>
+#include <cmath>
+
+namespace rn {
+  OutputBuffer::OutputBuffer(const char* path, size_t capacity) :
+    file_(std::fopen(path, "wb")),
+    buffer_(capacity),
+    size_(0),
+    failed_(false)
+  {
+
+  }
+
+  OutputBuffer::~OutputBuffer() {
+    close();
+  }
+
+  bool OutputBuffer::isOpen() const {
+    return file_ != nullptr;
+  }
+
+  bool OutputBuffer::close() {
+    if (!file_) return false;
+
+    flush();
+    failed_ |= std::fclose(file_) != 0;
+    file_ = nullptr;
+    return !failed_;
+  }
+
+  void OutputBuffer::write(const void* data, size_t length) {
+    if (size_ + length > buffer_.size()) {
+      flush();
+    }
+
+    if (length > buffer_.size()) { // больше буфера - пишем напрямую
+      if (file_ && std::fwrite(data, 1, length, file_) != length) failed_ = true;
+      return;
+    }
+
+    std::memcpy(buffer_.data() + size_, data, length);
+    size_ += length;
+  }
+
+  void OutputBuffer::write(const char* str) {
+    write(str, std::strlen(str));
+  }
+
+  void OutputBuffer::write(const std::string& str) {
+    write(str.data(), str.size());
+  }
+
+  char* OutputBuffer::reserve(size_t length) {
+    if (size_ + length > buffer_.size()) {
+      flush();
+    }
+
+    if (length > buffer_.size()) {
+      buffer_.resize(length);
+    }
+
+    return buffer_.data() + size_;
+  }
+
+  void OutputBuffer::commit(const char* end) {
+    size_ = end - buffer_.data();
+  }
+
+  void OutputBuffer::flush() {
+    if (file_ && size_ && std::fwrite(buffer_.data(), 1, size_, file_) != size_) {
+      failed_ = true;
+    }
+    size_ = 0;
+  }
+
+  namespace format {
+    static char* writeDigits(char* out, unsigned long long value, int min_digits) {
+      char digits[24];
+      int count = 0;
+      do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+      } while (value || count < min_digits);
+
+      while (count) {
+        *out++ = digits[--count];
+      }
+      return out;
+    }
+
+    char* toChars(char* out, long long value) {
+      if (value < 0) {
+        *out++ = '-';
+        return writeDigits(out, 0ull - static_cast<unsigned long long>(value), 1);
+      }
+
+      return writeDigits(out, static_cast<unsigned long long>(value), 1);
+    }
+
+    char* toChars(char* out, int value) {
+      return toChars(out, static_cast<long long>(value));
+    }
+
+    char* toChars(char* out, double value, int precision) {
+      static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+      precision = std::max(0, std::min(precision, 9));
+
+      double scaled = std::round(std::abs(value) * powers[precision]);
+      if (!(scaled < 1e18)) { // бесконечность, NaN или слишком большое число
+        return out + std::sprintf(out, "%g", value);
+      }
+
+      auto fixed = static_cast<unsigned long long>(scaled);
+      auto divider = static_cast<unsigned long long>(powers[precision]);
+      auto integral = fixed / divider, fraction = fixed % divider;
+
+      if (value < 0 && fixed) *out++ = '-';
+      out = writeDigits(out, integral, 1);
+
+      if (fraction) {
+        while (fraction % 10 == 0) {
+          fraction /= 10;
+          --precision;
+        }
+
+        *out++ = '.';
+        out = writeDigits(out, fraction, precision);
+      }
+
+      return out;
+    }
+  }
+}
@@ -0,0 +1,187 @@
+﻿#include <point-grid.h>
+#include <algorithm>
+#include <cmath>
+#include <defs.h>
+
+namespace rn {
+  PointGrid::PointGrid() :
+    min_(0, 0),
+    max_(0, 0),
+    cell_size_(1),
+    columns_(0),
+    rows_(0),
+    offset_(0, 0),
+    flip_x_(1)
+  {
+
+  }
+
+  PointGrid::PointGrid(const QVector<vec3i>& points) :
+    PointGrid()
+  {
+    if (points.isEmpty()) return;
+
+    min_ = max_ = points.front().projXY();
+    for (auto& e : points) {
+      min_.x = std::min(min_.x, e.x); min_.y = std::min(min_.y, e.y);
+      max_.x = std::max(max_.x, e.x); max_.y = std::max(max_.y, e.y);
+    }
+
+    // в среднем пара точек на ячейку
+    double width = max_.x - min_.x + 1, height = max_.y - min_.y + 1;
+    cell_size_ = std::max(1, static_cast<int>(std::ceil(std::sqrt(width * height * 2.0 / points.size()))));
+    columns_ = static_cast<int>(width + cell_size_ - 1) / cell_size_;
+    rows_ = static_cast<int>(height + cell_size_ - 1) / cell_size_;
+
+    auto cell_of = [this](const vec3i& e) {
+      return ((e.y - min_.y) / cell_size_) * columns_ + (e.x - min_.x) / cell_size_;
+    };
+
+    // сортировка подсчетом по ячейкам
+    cells_.fill(0, columns_ * rows_ + 1);
+    for (auto& e : points) {
+      ++cells_[cell_of(e) + 1];
+    }
+    for (int i = 1; i < cells_.size(); ++i) {
+      cells_[i] += cells_[i - 1];
+    }
+
+    QVector<int> next(cells_);
+    points_.resize(points.size());
+    for (auto& e : points) {
+      points_[next[cell_of(e)]++] = e.projXY();
+    }
+  }
+
+  int PointGrid::size() const {
+    return points_.size();
+  }
+
+  bool PointGrid::isEmpty() const {
+    return points_.isEmpty();
+  }
+
+  vec2i PointGrid::min() const {
+    return vec2i(std::min(toGlobal(min_).x, toGlobal(max_).x), min_.y + offset_.y);
+  }
+
+  vec2i PointGrid::max() const {
+    return vec2i(std::max(toGlobal(min_).x, toGlobal(max_).x), max_.y + offset_.y);
+  }
+
+  size_t PointGrid::memoryUsage() const {
+    return sizeof(*this) + points_.capacity() * sizeof(vec2i) + cells_.capacity() * sizeof(int);
+  }
+
+  void PointGrid::move(const vec2i& diff) {
+    offset_ += diff;
+  }
+
+  void PointGrid::mirror(int anchor) {
+    flip_x_ = -flip_x_;
+    offset_.x = 2 * anchor - offset_.x;
+  }
+
+  vec2i PointGrid::toLocal(const vec2i& point) const {
+    return vec2i((point.x - offset_.x) * flip_x_, point.y - offset_.y);
+  }
+
+  vec2i PointGrid::toGlobal(const vec2i& point) const {
+    return vec2i(flip_x_ * point.x + offset_.x, point.y + offset_.y);
+  }
+
+  long long PointGrid::sqrDistToBounds(const vec2i& local) const {
+    long long dx = std::max(0, std::max(min_.x - local.x, local.x - max_.x));
+    long long dy = std::max(0, std::max(min_.y - local.y, local.y - max_.y));
+    return dx * dx + dy * dy;
+  }
+
+  long long PointGrid::sqrNearest(const vec2i& point, long long sqr_limit) const {
+    if (isEmpty()) return sqr_limit;
+
+    auto local = toLocal(point);
+    if (sqrDistToBounds(local) >= sqr_limit) return sqr_limit;
+
+    // ячейка запроса (для точек вне сетки - ближайшая ячейка на границе)
+    int cx = std::min(std::max((local.x - min_.x) / cell_size_, 0), columns_ - 1);
+    int cy = std::min(std::max((local.y - min_.y) / cell_size_, 0), rows_ - 1);
+    if (local.x < min_.x) cx = 0;
+    if (local.y < min_.y) cy = 0;
+
+    long long best = sqr_limit;
+    auto visit = [&](int x, int y) {
+      if (x < 0 || y < 0 || x >= columns_ || y >= rows_) return;
+
+      int cell = y * columns_ + x;
+      for (int i = cells_[cell]; i < cells_[cell + 1]; ++i) {
+        long long dx = points_[i].x - local.x, dy = points_[i].y - local.y;
+        best = std::min(best, dx * dx + dy * dy);
+      }
+    };
+
+    // обходим кольца ячеек вокруг ячейки запроса; точки кольца r не ближе (r - 1) * cell_size_
+    int max_ring = std::max(columns_, rows_);
+    for (int r = 0; r <= max_ring; ++r) {
+      long long bound = static_cast<long long>(std::max(0, r - 1)) * cell_size_;
+      if (bound * bound >= best) break;
+
+      if (r == 0) {
+        visit(cx, cy);
+        continue;
+      }
+
+      for (int x = cx - r; x <= cx + r; ++x) {
+        visit(x, cy - r);
+        visit(x, cy + r);
+      }
+      for (int y = cy - r + 1; y <= cy + r - 1; ++y) {
+        visit(cx - r, y);
+        visit(cx + r, y);
+      }
+    }
+
+    return best;
+  }
+
+  bool PointGrid::anyIn(const vec2i& min, const vec2i& max) const {
+    if (isEmpty()) return false;
+
+    // прямоугольник в СК построения (при отражении края по x меняются местами)
+    auto a = toLocal(min), b = toLocal(max);
+    vec2i from(std::max(std::min(a.x, b.x), min_.x), std::max(std::min(a.y, b.y), min_.y));
+    vec2i to(std::min(std::max(a.x, b.x), max_.x), std::min(std::max(a.y, b.y), max_.y));
+    if (from.x > to.x || from.y > to.y) return false;
+
+    int cx1 = (from.x - min_.x) / cell_size_, cx2 = (to.x - min_.x) / cell_size_;
+    int cy1 = (from.y - min_.y) / cell_size_, cy2 = (to.y - min_.y) / cell_size_;
+    for (int y = cy1; y <= cy2; ++y) {
+      for (int x = cx1; x <= cx2; ++x) {
+        int cell = y * columns_ + x;
+        bool inner = x > cx1 && x < cx2 && y > cy1 && y < cy2; // ячейка целиком внутри прямоугольника
+        if (inner && cells_[cell] < cells_[cell + 1]) return true;
+
+        for (int i = cells_[cell]; !inner && i < cells_[cell + 1]; ++i) {
+          auto& e = points_[i];
+          if (e.x >= from.x && e.x <= to.x && e.y >= from.y && e.y <= to.y) return true;
+        }
+      }
+    }
+
+    return false;
+  }
+
+  double PointGrid::dist(const PointGrid& other) const {
+    // перебираем точки меньшей сетки, ближайшие ищем в большей
+    const PointGrid& query = size() <= other.size() ? *this : other;
+    const PointGrid& index = size() <= other.size() ? other : *this;
+    if (query.isEmpty()) return Double::max();
+
+    long long best = Type<long long>::max();
+    for (auto& e : query.points_) {
+      best = index.sqrNearest(query.toGlobal(e), best);
+      if (best == 0) break;
+    }
+
+    return std::sqrt(static_cast<double>(best));
+  }
+}
@@ -0,0 +1,123 @@
+﻿#include <point-kernels.h>
+#include <algorithm>
+#include <cmath>
+#include <QtGlobal>
+#include <defs.h>
+
+namespace rn {
+  Points3d::Points3d(int count) {
+    resize(count);
+  }
+
+  Points3d::Points3d(const vec3i* points, int count, const vec3i& origin) :
+    Points3d(count)
+  {
+    for (int i = 0; i < count; ++i) {
+      x[i] = points[i].x - origin.x;
+      y[i] = points[i].y - origin.y;
+      z[i] = points[i].z - origin.z;
+    }
+  }
+
+  int Points3d::size() const {
+    return static_cast<int>(x.size());
+  }
+
+  void Points3d::resize(int count) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+  }
+
+  vec3d Points3d::at(int i) const {
+    return vec3d(x[i], y[i], z[i]);
+  }
+
+  void Points3d::set(int i, const vec3d& p) {
+    x[i] = p.x;
+    y[i] = p.y;
+    z[i] = p.z;
+  }
+
+  void Points3d::store(vec3i* dst, const vec3i& shift) const {
+    for (int i = 0; i < size(); ++i) {
+      dst[i] = vec3i(int(x[i]) + shift.x, int(y[i]) + shift.y, int(z[i]) + shift.z);
+    }
+  }
+
+  namespace kernels {
+    void transform(const Points3d& src, const mat3d& m, Points3d& dst) {
+      dst.resize(src.size());
+      transform(src, m, dst, 0, src.size());
+    }
+
+    void transform(const Points3d& src, const mat3d& m, Points3d& dst, int from, int count) {
+      Q_ASSERT(from >= 0 && from + count <= std::min(src.size(), dst.size()));
+
+      const double *sx = src.x.data() + from, *sy = src.y.data() + from, *sz = src.z.data() + from;
+      double *dx = dst.x.data() + from, *dy = dst.y.data() + from, *dz = dst.z.data() + from;
+      for (int i = 0; i < count; ++i) {
+        // порядок слагаемых - как в vec3 * mat3, результаты совпадают до бита
+        double x = sx[i], y = sy[i], z = sz[i];
+        dx[i] = m(0, 0)*x + m(1, 0)*y + m(2, 0)*z;
+        dy[i] = m(0, 1)*x + m(1, 1)*y + m(2, 1)*z;
+        dz[i] = m(0, 2)*x + m(1, 2)*y + m(2, 2)*z;
+      }
+    }
+
+    void cross(const Points3d& a, const Points3d& b, Points3d& dst) {
+      int count = std::min(a.size(), b.size());
+      dst.resize(count);
+
+      const double *ax = a.x.data(), *ay = a.y.data(), *az = a.z.data();
+      const double *bx = b.x.data(), *by = b.y.data(), *bz = b.z.data();
+      double *dx = dst.x.data(), *dy = dst.y.data(), *dz = dst.z.data();
+      for (int i = 0; i < count; ++i) {
+        double x = ay[i]*bz[i] - az[i]*by[i];
+        double y = az[i]*bx[i] - ax[i]*bz[i];
+        double z = ax[i]*by[i] - ay[i]*bx[i];
+        dx[i] = x; dy[i] = y; dz[i] = z;
+      }
+    }
+
+    void orient(Points3d& normals, const Points3d& directions) {
+      int count = std::min(normals.size(), directions.size());
+
+      double *nx = normals.x.data(), *ny = normals.y.data(), *nz = normals.z.data();
+      const double *ex = directions.x.data(), *ey = directions.y.data(), *ez = directions.z.data();
+      for (int i = 0; i < count; ++i) {
+        // угол больше прямого - отрицательный косинус; знак берем по скалярному произведению, а не через
+        // acos: для строго противоположных векторов аргумент acos из-за округления выходил за -1 (NaN),
+        // и такие нормали не разворачивались
+        double dot = nx[i]*ex[i] + ny[i]*ey[i] + nz[i]*ez[i];
+        double sign = dot < 0.0 ? -1.0 : 1.0;
+        nx[i] *= sign; ny[i] *= sign; nz[i] *= sign;
+      }
+    }
+
+    void normalize(Points3d& vectors) {
+      int count = vectors.size();
+
+      double *vx = vectors.x.data(), *vy = vectors.y.data(), *vz = vectors.z.data();
+      for (int i = 0; i < count; ++i) {
+        double t = std::sqrt(vx[i]*vx[i] + vy[i]*vy[i] + vz[i]*vz[i]);
+        vx[i] /= t; vy[i] /= t; vz[i] /= t;
+      }
+    }
+
+    double minDistXY(const vec2d& p, const Points3d& points) {
+      int count = points.size();
+
+      if (count == 0) return Double::max();
+
+      const double *px = points.x.data(), *py = points.y.data();
+      double best = Double::max();
+      for (int i = 0; i < count; ++i) {
+        double dx = px[i] - p.x, dy = py[i] - p.y;
+        best = std::min(best, dx*dx + dy*dy);
+      }
+
+      return std::sqrt(best);
+    }
+  }
+}
@@ -33,6 +33,6 @@ void PointsMover::setGradientDir(std::shared_ptr<ip::Image<double>> dir) {
   grad_dir_ = dir;
 }
 
-void PointsMover::setPrevLayers(const QVector<QVector<vec2i>>& layers) {
+void PointsMover::setPrevLayers(const rn::AnchorLayers& layers) {
   prev_layers_ = layers;
 }
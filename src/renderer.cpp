@@ -0,0 +1,135 @@
+﻿#include <renderer.h>
+#include <QtOpenGL>
+
+namespace rn {
+  void Renderer::render(const Mesh& mesh, const vec3b& color, bool texturing, bool selected) const {
+    bool use_texture = texturing && !mesh.tex_coord.empty();
+
+    glEnable(GL_NORMALIZE);
+    glEnable(GL_LIGHTING);
+
+    if (use_texture) {
+      glEnable(GL_TEXTURE_2D);
+    }
+
+    // перенос и отражение модели не применены к вершинам - задаем их матрицей
+    auto offset = mesh.offset();
+    glPushMatrix();
+    glTranslated(offset.x, offset.y, offset.z);
+    glScaled(mesh.mirrored() ? -1.0 : 1.0, 1.0, 1.0);
+
+    if (selected) glColor3ub(255, 0, 0);
+    else if (use_texture) glColor3ub(255, 255, 255);
+    else glColor3ubv(color.coords);
+
+    glCallList(displayList(mesh, use_texture));
+
+    if (use_texture) {
+      glDisable(GL_TEXTURE_2D);
+    }
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_NORMALIZE);
+
+  #ifndef NDEBUG
+    if (selected && use_texture) {
+      glLineWidth(5);
+      glColor3d(1, 0, 0);
+      glBegin(GL_LINE_STRIP);
+      for(auto &e: mesh.anchor_points) glVertex2iv(e[0].coords);
+      glEnd();
+      glBegin(GL_LINE_STRIP);
+      for (auto &e: mesh.anchor_points) glVertex2iv(e[1].coords);
+      glEnd();
+      glLineWidth(1);
+    }
+  #endif
+    glPopMatrix();
+    glColor3d(1, 1, 1);
+  }
+
+  unsigned int Renderer::displayList(const Mesh& mesh, bool texturing) const {
+    quint64 key = mesh.geometryId() * 2 + (texturing ? 1 : 0);
+    auto it = lists_.find(key);
+    if (it != lists_.end()) {
+      it.value().frame = frame_;
+      return it.value().id;
+    }
+
+    DisplayList list{ glGenLists(1), frame_ };
+    glNewList(list.id, GL_COMPILE);
+
+    // индексированные массивы компактного представления; данные копируются в список при компиляции
+    auto compact_ptr = mesh.compact();
+    auto& compact = *compact_ptr;
+    std::vector<vec3f> normals;
+    normals.reserve(compact.normals.size());
+    for (auto code : compact.normals) {
+      normals.push_back(decodeNormal(code));
+    }
+
+    bool with_uv = texturing && !compact.tex_coord.empty();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, compact.positions.data());
+    glNormalPointer(GL_FLOAT, 0, normals.data());
+    if (with_uv) {
+      glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+      glTexCoordPointer(2, GL_FLOAT, 0, compact.tex_coord.data());
+    }
+
+    glDrawElements(GL_TRIANGLES, GLsizei(compact.indices.size() * 3), GL_UNSIGNED_INT, compact.indices.data());
+
+    if (with_uv) glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glEndList();
+    lists_.insert(key, list);
+    return list.id;
+  }
+
+  void Renderer::collect() {
+    for (auto it = lists_.begin(); it != lists_.end();) {
+      if (it.value().frame != frame_) {
+        glDeleteLists(it.value().id, 1);
+        it = lists_.erase(it);
+      }
+      else {
+        ++it;
+      }
+    }
+
+    ++frame_;
+  }
+
+  void Renderer::render(const ModelCreator::Preview& preview) const {
+    glPushMatrix();
+    glLoadIdentity();
+    if (preview.line.size() == 2) {
+      glLineWidth(3);
+      glColor3d(0, 0, 1);
+      glBegin(GL_LINES);
+      glVertex3d(preview.line.front().x, preview.line.front().y, -100);
+      glVertex3d(preview.line.back().x, preview.line.back().y, -100);
+      glEnd();
+    }
+
+    if (!preview.ellipse.isEmpty()) {
+      glLineWidth(3);
+      glColor3d(1, 0, 0);
+      glBegin(GL_LINE_LOOP);
+      for (auto &e : preview.ellipse) glVertex3d(e.x, e.y, 100);
+      glEnd();
+    }
+
+    glPopMatrix();
+
+    if (preview.mesh) {
+      render(*preview.mesh, vec3b(70, 130, 180), false);
+    }
+
+    glLineWidth(1);
+    glColor3d(1, 1, 1);
+  }
+}
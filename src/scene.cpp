@@ -0,0 +1,164 @@
+﻿#include <scene.h>
+
+namespace rn {
+  Scene::Scene() :
+    selected_count_(0)
+  {
+
+  }
+
+  int Scene::size() const {
+    return meshes_.size();
+  }
+
+  bool Scene::isEmpty() const {
+    return meshes_.isEmpty();
+  }
+
+  const Mesh::HardPtr& Scene::operator[](int index) const {
+    return meshes_[index];
+  }
+
+  QVector<Mesh::HardPtr>::const_iterator Scene::begin() const {
+    return meshes_.begin();
+  }
+
+  QVector<Mesh::HardPtr>::const_iterator Scene::end() const {
+    return meshes_.end();
+  }
+
+  Scene::Handle Scene::handle(int index) const {
+    Q_ASSERT(index >= 0 && index < meshes_.size());
+
+    Handle handle;
+    handle.slot = slots_of_[index];
+    handle.generation = slots_[handle.slot].generation;
+    return handle;
+  }
+
+  int Scene::indexOf(const Handle& handle) const {
+    if (handle.slot < 0 || handle.slot >= slots_.size()) return -1;
+
+    auto& slot = slots_[handle.slot];
+    return slot.generation == handle.generation ? slot.index : -1;
+  }
+
+  bool Scene::contains(const Handle& handle) const {
+    return indexOf(handle) >= 0;
+  }
+
+  Mesh::HardPtr Scene::get(const Handle& handle) const {
+    int index = indexOf(handle);
+    return index >= 0 ? meshes_[index] : Mesh::HardPtr();
+  }
+
+  Scene::Handle Scene::insert(Mesh::HardPtr mesh, bool selected) {
+    int slot;
+    if (!free_slots_.isEmpty()) {
+      slot = free_slots_.back();
+      free_slots_.pop_back();
+    }
+    else {
+      slot = slots_.size();
+      slots_.push_back(Slot{ -1, 0 });
+    }
+
+    slots_[slot].index = meshes_.size();
+    meshes_.push_back(mesh);
+    selected_.push_back(selected);
+    slots_of_.push_back(slot);
+    if (selected) ++selected_count_;
+
+    return handle(meshes_.size() - 1);
+  }
+
+  void Scene::remove(const Handle& handle) {
+    int index = indexOf(handle);
+    if (index < 0) return;
+
+    if (selected_[index]) --selected_count_;
+
+    // на место удаляемой модели переносим последнюю
+    int last = meshes_.size() - 1;
+    if (index != last) {
+      meshes_[index] = meshes_[last];
+      selected_[index] = selected_[last];
+      slots_of_[index] = slots_of_[last];
+      slots_[slots_of_[index]].index = index;
+    }
+
+    meshes_.pop_back();
+    selected_.pop_back();
+    slots_of_.pop_back();
+
+    auto& slot = slots_[handle.slot];
+    slot.index = -1;
+    ++slot.generation;
+    free_slots_.push_back(handle.slot);
+  }
+
+  void Scene::replace(const Handle& handle, Mesh::HardPtr mesh) {
+    int index = indexOf(handle);
+    if (index >= 0) meshes_[index] = mesh;
+  }
+
+  void Scene::clear() {
+    // поколения слотов сохраняются, чтобы старые дескрипторы не подошли к новым моделям
+    for (int slot : slots_of_) {
+      slots_[slot].index = -1;
+      ++slots_[slot].generation;
+      free_slots_.push_back(slot);
+    }
+
+    meshes_.clear();
+    selected_.clear();
+    slots_of_.clear();
+    selected_count_ = 0;
+  }
+
+  bool Scene::isSelected(int index) const {
+    return selected_[index];
+  }
+
+  void Scene::setSelected(const Handle& handle, bool selected) {
+    int index = indexOf(handle);
+    if (index < 0 || bool(selected_[index]) == selected) return;
+
+    selected_[index] = selected;
+    selected_count_ += selected ? 1 : -1;
+  }
+
+  void Scene::clearSelection() {
+    if (selected_count_ == 0) return;
+
+    selected_.fill(false);
+    selected_count_ = 0;
+  }
+
+  int Scene::selectedCount() const {
+    return selected_count_;
+  }
+
+  QVector<Scene::Handle> Scene::selection() const {
+    QVector<Handle> handles;
+    handles.reserve(selected_count_);
+    for (int i = 0; i < meshes_.size(); ++i) {
+      if (selected_[i]) handles.push_back(handle(i));
+    }
+
+    return handles;
+  }
+
+  QList<Mesh::HardPtr> Scene::meshes() const {
+    return meshes_.toList();
+  }
+
+  QList<Mesh::HardPtr> Scene::selectedMeshes() const {
+    QList<Mesh::HardPtr> meshes;
+    for (int i = 0; i < meshes_.size(); ++i) {
+      if (selected_[i]) meshes.push_back(meshes_[i]);
+    }
+
+    return meshes;
+  }
+}
@@ -1,60 +1,137 @@
 ﻿#include <session.h>
+#include <algorithm>
 #include <cmath>
 
 namespace rn {
-  Session::Session(const QImage& src, QGLWidget* parent) :
-    parent_(parent),
+  Session::Session(const QImage& src) :
     slices(16),
     step(4),
+    tolerance(0),
     image(src)
   {
-    Q_ASSERT(parent_);
-
-    if (image.width() > MIN_SCENE_WIDTH * 0.85 || image.height() > MIN_SCENE_HEIGHT * 0.85) {
-      image = image.scaled(MIN_SCENE_WIDTH * 0.85, MIN_SCENE_HEIGHT * 0.85, Qt::KeepAspectRatio);
-    }
-
     ip::Image<double> source(image);
     ip::Image<double> u(source.size()), v(source.size());
     source.gvf(0.05, 64, u, v);
 
     gvf.reset(new ip::Image<double>(ip::Image<double>::unite(u, v, std::hypot).scale(0, 255))); // модуль поля потока градиента
     gvf_dir.reset(new ip::Image<double>(ip::Image<double>::unite(v, u, std::atan2))); // модуль поля потока градиента - `atan (v, u)`
+  }
 
-    texture_ = parent_->bindTexture(image, GL_TEXTURE_2D);
-    gvf_texture_ = parent_->bindTexture(gvf->toQImage(), GL_TEXTURE_2D);
+  void Session::commit() {
+    history_.push(scene, scene); // массивы сцены разделяются до первого изменения
+  }
 
-    checkOpenGLErrors();
+  void Session::rollback() {
+    Q_ASSERT(!history_.isEmpty());
+
+    scene = history_.pop();
+    scene.clearSelection();
   }
 
-  Session::~Session() {
-    parent_->deleteTexture(texture_);
-    parent_->deleteTexture(gvf_texture_);
+  bool Session::hasBackups() const {
+    return !history_.isEmpty();
   }
 
-  void Session::commit() {
-    backups_.push_back(meshes);
+  int Session::backupsCount() const {
+    return history_.size();
   }
 
-  void Session::rollback() {
-    Q_ASSERT(!backups_.isEmpty());
+  void Session::updateBackups() {
+    history_.update(scene);
+  }
 
-    selected_meshes.clear();
-    meshes = backups_.back();
-    backups_.pop_back();
+  size_t Session::backupsFootprint() const {
+    return history_.footprint();
   }
 
-  bool Session::hasBackups() const {
-    return !backups_.isEmpty();
+  void Session::setBackupsBudget(size_t bytes) {
+    history_.setBudget(bytes);
+    history_.update(scene);
+  }
+
+  Session::HardPtr Session::snapshot() const {
+    HardPtr dst(new Session());
+    dst->offsets = offsets;
+    dst->screen_size = screen_size;
+    dst->slices = slices;
+    dst->step = step;
+    dst->tolerance = tolerance;
+    dst->image = image; // неявно разделяемые данные, копирования пикселей нет
+    dst->gvf = gvf;
+    dst->gvf_dir = gvf_dir;
+    return dst;
   }
 
   void Session::invertStep() {
     step = -step;
   }
 
-  void Session::addMesh(Mesh::HardPtr mesh) {
-    mesh->texture_id = texture(); // на всякий случай
-    meshes.push_back(mesh);
+  Scene::Handle Session::addMesh(Mesh::HardPtr mesh) {
+    return scene.insert(mesh);
+  }
+
+  void Session::updateIndex() {
+    bool same_meshes = indexed_meshes_.size() == scene.size();
+    for (int i = 0; same_meshes && i < scene.size(); ++i) {
+      same_meshes = indexed_meshes_[i] == scene[i].get();
+    }
+
+    if (!same_meshes) {
+      indexed_meshes_.clear();
+      indexed_bounds_.clear();
+      for (auto& mesh : scene) {
+        indexed_meshes_.push_back(mesh.get());
+        indexed_bounds_.push_back(mesh->bounds());
+      }
+
+      index_ = rn::BoxTree(indexed_bounds_);
+      return;
+    }
+
+    // габариты моделей кешируются в них самих, сверка дешевая
+    for (int i = 0; i < scene.size(); ++i) {
+      auto bounds = scene[i]->bounds();
+      auto& indexed = indexed_bounds_[i];
+      if (bounds.contains(indexed) && indexed.contains(bounds)) continue;
+
+      indexed = bounds;
+      index_.update(i, bounds);
+    }
+  }
+
+  QVector<Scene::Handle> Session::meshesIn(const QRect& rect) {
+    updateIndex();
+
+    QRect area = rect.normalized();
+    rn::BoxTree::Box box(vec2i(area.left(), area.top()), vec2i(area.right(), area.bottom()));
+    auto found = index_.find(box);
+    std::sort(found.begin(), found.end()); // в порядке хранения моделей
+
+    QVector<Scene::Handle> result;
+    for (int i : found) {
+      // модель целиком внутри области - вершины заведомо попадают в нее
+      bool inside = !scene[i]->vertices.isEmpty() && box.contains(indexed_bounds_[i]);
+      if (inside || scene[i]->fallsInto(rect)) result.push_back(scene.handle(i));
+    }
+
+    return result;
+  }
+
+  Scene::Handle Session::pick(const rn::Ray& ray, int* triangle) const {
+    Scene::Handle picked;
+    double best = Double::max();
+    for (int i = 0; i < scene.size(); ++i) {
+      // ближайшее найденное пересечение отсекает узлы иерархий следующих моделей
+      int index = -1;
+      double t = scene[i]->intersect(ray, best, &index);
+      if (t < best) {
+        best = t;
+        picked = scene.handle(i);
+        if (triangle) *triangle = index;
+      }
+    }
+
+    return picked;
   }
 
   void Session::setLastLayer(const QVector<vec2i>& layer) {
@@ -76,19 +153,4 @@ namespace rn {
   vec2i Session::screenCenter() const {
     return screen_size / 2;
   }
-
-  void Session::checkOpenGLErrors() {
-    GLenum err_code;
-    if ((err_code = glGetError()) != GL_NO_ERROR) {
-      qDebug() << "OpenGL error:" << err_code << endl;
-    }
-  }
-
-  GLuint Session::texture() const {
-    return texture_;
-  }
-
-  GLuint Session::gvfTexture() const {
-    return gvf_texture_;
-  }
 }
@@ -4,7 +4,7 @@
 
 #include <algebra.h>
 
-void SymmetricPointsMover::move(QVector<vec2i>& points)  {
+void SymmetricPointsMover::move(rn::AnchorLayer& points)  {
   // TODO Проверять параметры - заданы ли нужные
 
   // сдвинули на уровень нового слоя
@@ -68,3 +68,7 @@ void SymmetricPointsMover::move(QVector<vec2i>& points)  {
   points[0] -= offset_;
   points[1] -= offset_;
 }
+
+std::shared_ptr<PointsMover> SymmetricPointsMover::clone() const {
+  return std::make_shared<SymmetricPointsMover>(*this);
+}
@@ -0,0 +1,196 @@
+﻿#include <triangle-tree.h>
+#include <algorithm>
+#include <cmath>
+#include <mesh.h>
+#include <defs.h>
+
+namespace rn {
+  namespace {
+    const int max_leaf_size = 4;
+
+    // пересечение луча с параллелепипедом методом плит; inv_dir - покомпонентно обратное направление
+    bool hitsBox(const vec3d& min, const vec3d& max, const vec3d& origin, const vec3d& inv_dir, double limit) {
+      double t_min = 0.0, t_max = limit;
+      for (int i = 0; i < 3; ++i) {
+        if (std::isinf(inv_dir.coords[i])) { // луч параллелен плитам: 0 * inf дало бы NaN
+          if (origin.coords[i] < min.coords[i] || origin.coords[i] > max.coords[i]) return false;
+          continue;
+        }
+
+        double t1 = (min.coords[i] - origin.coords[i]) * inv_dir.coords[i];
+        double t2 = (max.coords[i] - origin.coords[i]) * inv_dir.coords[i];
+        t_min = std::max(t_min, std::min(t1, t2));
+        t_max = std::min(t_max, std::max(t1, t2));
+      }
+
+      return t_min <= t_max;
+    }
+  }
+
+  TriangleTree::TriangleTree() :
+    offset_(0, 0, 0),
+    flip_x_(1)
+  {
+
+  }
+
+  TriangleTree::TriangleTree(const Mesh& mesh) :
+    TriangleTree()
+  {
+    tris_.reserve(mesh.triangles.size() + mesh.top_cover.triangles.size() + mesh.bottom_cover.triangles.size());
+    for (auto triangles : { &mesh.triangles, &mesh.top_cover.triangles, &mesh.bottom_cover.triangles }) {
+      for (auto& e : *triangles) {
+        Tri tri;
+        tri.a = mesh[e[0]].to<double>();
+        tri.ab = mesh[e[1]].to<double>() - tri.a;
+        tri.ac = mesh[e[2]].to<double>() - tri.a;
+        tri.index = tris_.size();
+        tris_.push_back(tri);
+      }
+    }
+
+    if (tris_.isEmpty()) return;
+
+    QVector<vec3d> centers;
+    centers.reserve(tris_.size());
+    for (auto& e : tris_) {
+      centers.push_back(e.a + (e.ab + e.ac) / 3.0);
+    }
+
+    nodes_.reserve(2 * tris_.size());
+    nodes_.push_back(Node());
+    build(0, 0, tris_.size(), centers);
+  }
+
+  void TriangleTree::build(int node, int begin, int end, QVector<vec3d>& centers) {
+    vec3d min(Double::max(), Double::max(), Double::max());
+    vec3d max(Double::lowest(), Double::lowest(), Double::lowest());
+    vec3d center_min = min, center_max = max;
+    for (int i = begin; i < end; ++i) {
+      auto& e = tris_[i];
+      for (auto& p : { e.a, e.a + e.ab, e.a + e.ac }) {
+        for (int k = 0; k < 3; ++k) {
+          min.coords[k] = std::min(min.coords[k], p.coords[k]);
+          max.coords[k] = std::max(max.coords[k], p.coords[k]);
+        }
+      }
+
+      for (int k = 0; k < 3; ++k) {
+        center_min.coords[k] = std::min(center_min.coords[k], centers[i].coords[k]);
+        center_max.coords[k] = std::max(center_max.coords[k], centers[i].coords[k]);
+      }
+    }
+
+    nodes_[node].min = min;
+    nodes_[node].max = max;
+    if (end - begin <= max_leaf_size) {
+      nodes_[node].first = begin;
+      nodes_[node].count = end - begin;
+      return;
+    }
+
+    // делим пополам по медиане центров вдоль наибольшего разброса
+    vec3d extent = center_max - center_min;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+    QVector<int> order(end - begin);
+    for (int i = 0; i < order.size(); ++i) {
+      order[i] = begin + i;
+    }
+
+    int middle = order.size() / 2;
+    std::nth_element(order.begin(), order.begin() + middle, order.end(), [&centers, axis](int a, int b) {
+      return centers[a].coords[axis] < centers[b].coords[axis];
+    });
+
+    QVector<Tri> tris;
+    QVector<vec3d> tri_centers;
+    tris.reserve(order.size());
+    tri_centers.reserve(order.size());
+    for (int i : order) {
+      tris.push_back(tris_[i]);
+      tri_centers.push_back(centers[i]);
+    }
+    std::copy(tris.begin(), tris.end(), tris_.begin() + begin);
+    std::copy(tri_centers.begin(), tri_centers.end(), centers.begin() + begin);
+
+    int first = nodes_.size();
+    nodes_.push_back(Node());
+    nodes_.push_back(Node());
+    nodes_[node].first = first;
+    nodes_[node].count = 0;
+
+    build(first, begin, begin + middle, centers);
+    build(first + 1, begin + middle, end, centers);
+  }
+
+  int TriangleTree::size() const {
+    return tris_.size();
+  }
+
+  bool TriangleTree::isEmpty() const {
+    return tris_.isEmpty();
+  }
+
+  size_t TriangleTree::memoryUsage() const {
+    return sizeof(*this) + tris_.capacity() * sizeof(Tri) + nodes_.capacity() * sizeof(Node);
+  }
+
+  void TriangleTree::move(const vec3d& diff) {
+    offset_ += diff;
+  }
+
+  void TriangleTree::mirror(int anchor) {
+    flip_x_ = -flip_x_;
+    offset_.x = 2 * anchor - offset_.x;
+  }
+
+  double TriangleTree::intersect(const Ray& ray, double limit, int* triangle) const {
+    if (isEmpty()) return limit;
+
+    // луч в СК построения; преобразование сохраняет длины, поэтому t не меняется
+    vec3d origin((ray.origin.x - offset_.x) * flip_x_, ray.origin.y - offset_.y, ray.origin.z - offset_.z);
+    vec3d dir(ray.dir.x * flip_x_, ray.dir.y, ray.dir.z);
+    vec3d inv_dir(1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z);
+
+    double best = limit;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+      auto& node = nodes_[stack[--top]];
+      if (!hitsBox(node.min, node.max, origin, inv_dir, best)) continue;
+
+      if (node.count == 0) {
+        stack[top++] = node.first;
+        stack[top++] = node.first + 1;
+        continue;
+      }
+
+      // Моллер - Трумбор, обе стороны треугольника
+      for (int i = node.first; i < node.first + node.count; ++i) {
+        auto& e = tris_[i];
+        vec3d p = dir.cross(e.ac);
+        double det = e.ab.dot(p);
+        if (std::abs(det) < 1e-12) continue;
+
+        double inv_det = 1.0 / det;
+        vec3d s = origin - e.a;
+        double u = s.dot(p) * inv_det;
+        if (u < 0.0 || u > 1.0) continue;
+
+        vec3d q = s.cross(e.ab);
+        double v = dir.dot(q) * inv_det;
+        if (v < 0.0 || u + v > 1.0) continue;
+
+        double t = e.ac.dot(q) * inv_det;
+        if (t >= 0.0 && t < best) {
+          best = t;
+          if (triangle) *triangle = e.index;
+        }
+      }
+    }
+
+    return best;
+  }
+}
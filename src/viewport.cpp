@@ -22,6 +22,8 @@ namespace rn
   /* Viewport */
   Viewport::Viewport(QWidget* parent) :
     QGLWidget(QGLFormat(QGL::DoubleBuffer | QGL::DepthBuffer | QGL::Rgba), parent),
+    texture_(0),
+    gvf_texture_(0),
     hide_image(false),
     show_force_field(false),
     trackball(new Trackball(/*Trackball::VerticalInverse*/))
@@ -31,7 +33,20 @@ namespace rn
   }
 
   Viewport::~Viewport(void) {
+    releaseTextures();
+  }
+
+  void Viewport::releaseTextures() {
+    if (texture_) deleteTexture(texture_);
+    if (gvf_texture_) deleteTexture(gvf_texture_);
+    texture_ = gvf_texture_ = 0;
+  }
 
+  void Viewport::checkOpenGLErrors() {
+    GLenum err_code;
+    if ((err_code = glGetError()) != GL_NO_ERROR) {
+      qDebug() << "OpenGL error:" << err_code << endl;
+    }
   }
 
   void Viewport::drawMesh(const mesh_t& mesh) {
@@ -154,9 +169,17 @@ namespace rn
 
   void Viewport::setSession(rn::Session::HardPtr session) {
     session_ = session;
+    hovered_mesh = Scene::Handle();
     session_->screen_size = vec2i(scene_size_.width(), scene_size_.height());
     session_->offsets.x = (scene_size_.width() - session_->width()) / 2;
     session_->offsets.y = (scene_size_.height() - session_->height()) / 2;
+
+    makeCurrent();
+    releaseTextures();
+    texture_ = bindTexture(session_->image, GL_TEXTURE_2D);
+    gvf_texture_ = bindTexture(session_->gvf->toQImage(), GL_TEXTURE_2D);
+
+    checkOpenGLErrors();
   }
   
   void Viewport::makeScreenshot(const QString& filename) {
@@ -185,6 +208,34 @@ namespace rn
     updateGL();
   }
 
+  rn::Ray Viewport::pickRay(const QPoint& pos) {
+    makeCurrent();
+
+    GLdouble modelview[16], projection[16];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+
+    auto to_matrix = [](const GLdouble* data) {
+      float values[16];
+      for (int i = 0; i < 16; ++i) {
+        values[i] = static_cast<float>(data[i]);
+      }
+
+      return QMatrix4x4(values).transposed(); // OpenGL хранит матрицы по столбцам
+    };
+
+    // переводим точку на ближней и дальней плоскостях отсечения из нормированных координат в СК сцены
+    QMatrix4x4 unproject = (to_matrix(projection) * to_matrix(modelview)).inverted();
+    float x = 2.0f * pos.x() / width() - 1.0f;
+    float y = 1.0f - 2.0f * pos.y() / height();
+    QVector3D near_point = unproject.map(QVector3D(x, y, -1.0f));
+    QVector3D far_point = unproject.map(QVector3D(x, y, 1.0f));
+
+    vec3d origin(near_point.x(), near_point.y(), near_point.z());
+    vec3d dir(far_point.x() - origin.x, far_point.y() - origin.y, far_point.z() - origin.z);
+    return rn::Ray(origin, dir);
+  }
+
   void Viewport::initializeGL() {
     QGLWidget::initializeGL();
     qglClearColor(Qt::black);
@@ -236,7 +287,7 @@ namespace rn
 
     if (session_) {
       glColor3d(1.0, 1.0, 1.0);
-      auto texture_id = show_force_field ? session_->gvfTexture() : session_->texture();
+      auto texture_id = show_force_field ? gvf_texture_ : texture_;
       glBindTexture(GL_TEXTURE_2D, texture_id);
 
       if (!hide_image) { // рисуем текстуру изображения
@@ -257,17 +308,24 @@ namespace rn
         glPopMatrix();
       }
 
-      model_creator->render();
+      renderer_.render(model_creator->preview());
 
-      for (auto& mesh : session_->meshes) {
-        if (!session_->selected_meshes.contains(mesh)) {
-          mesh->render();
+      glBindTexture(GL_TEXTURE_2D, texture_); // меши текстурируются исходным изображением
+      auto& scene = session_->scene;
+      int hovered = scene.indexOf(hovered_mesh);
+      for (int i = 0; i < scene.size(); ++i) {
+        if (scene.isSelected(i)) {
+          renderer_.render(*scene[i], vec3b(180, 0, 0), true, true);
+        }
+        else if (i == hovered) {
+          renderer_.render(*scene[i], vec3b(230, 160, 40), false);
+        }
+        else {
+          renderer_.render(*scene[i]);
         }
       }
 
-      for (auto& mesh : session_->selected_meshes) {
-        mesh->render(vec3b(180, 0, 0), true, true);
-      }
+      renderer_.collect();
     }
 
     if (!selected_area.isEmpty()) {
@@ -305,6 +363,13 @@ namespace rn
     paintGL();
   }
 
+  void Viewport::setViewRotation(double degrees, double x, double y) {
+    makeCurrent();
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glRotated(degrees, x, y, 0);
+  }
+
   void Viewport::wheelEvent(QWheelEvent* event) {
     emit signalWheelEvent(event);
   }